@@ -0,0 +1,79 @@
+#include <SX126x.h>
+#include <LoRaScanner.h>
+
+SX126x LoRa;
+
+// Scan CAD on 3 channels with SF 7 and SF 8 using 125 kHz bandwidth and preamble length 12
+LoRaScanner<SX126x> Scanner(LoRa, 125000, 12);
+
+void setup() {
+
+  // Begin serial communication
+  Serial.begin(38400);
+
+  // Begin LoRa radio and set NSS, reset, busy, IRQ, txen, and rxen pin with connected arduino pins
+  Serial.println("Begin LoRa radio");
+  int8_t nssPin = 10, resetPin = 9, busyPin = 4, irqPin = -1, txenPin = 8, rxenPin = 7;
+  if (!LoRa.begin(nssPin, resetPin, busyPin, irqPin, txenPin, rxenPin)){
+    Serial.println("Something wrong, can't begin LoRa radio");
+    while(1);
+  }
+
+  // Configure TCXO or XTAL used in RF module
+  Serial.println("Set RF module to use TCXO as clock reference");
+  uint8_t dio3Voltage = SX126X_DIO3_OUTPUT_1_8;
+  uint32_t tcxoDelay = SX126X_TCXO_DELAY_10;
+  LoRa.setDio3TcxoCtrl(dio3Voltage, tcxoDelay);
+
+  // Configure packet parameter with same preamble length used by scanner
+  Serial.println("Set packet parameters:\n\tExplicit header type\n\tPreamble length = 12\n\tPayload Length = 15\n\tCRC on");
+  LoRa.setLoRaPacket(SX126X_HEADER_EXPLICIT, 12, 15, true);
+  LoRa.setSyncWord(0x3444);
+
+  // Add channel and SF pairs to be scanned
+  Scanner.addChannel(915200000, 7);
+  Scanner.addChannel(915200000, 8);
+  Scanner.addChannel(915400000, 7);
+  Scanner.addChannel(915400000, 8);
+  Scanner.addChannel(915600000, 7);
+  Scanner.addChannel(915600000, 8);
+
+  // Check full scan cycle fit inside preamble so packet on every channel can be captured
+  Serial.print("Scan cycle time = ");
+  Serial.print(Scanner.cycleTime());
+  Serial.println(" us");
+  if (!Scanner.fitsPreamble()) Serial.println("Scan cycle longer than preamble, some packets may be missed");
+
+  Serial.println("\n-- LORA SCANNER --\n");
+
+}
+
+void loop() {
+
+  // Scan channels and check for incoming LoRa packet
+  if (Scanner.scan()) {
+
+    // Read received packet
+    const uint8_t msgLen = LoRa.available();
+    char message[msgLen + 1];
+    LoRa.read(message, msgLen);
+    message[msgLen] = 0;
+
+    // Print received message with channel frequency and SF
+    Serial.print(message);
+    Serial.print("  ");
+    Serial.print(Scanner.frequency());
+    Serial.print(" Hz SF");
+    Serial.println(Scanner.spreadingFactor());
+
+    // Print packet/signal status including package RSSI and SNR
+    Serial.print("Packet status: RSSI = ");
+    Serial.print(LoRa.packetRssi());
+    Serial.print(" dBm | SNR = ");
+    Serial.print(LoRa.snr());
+    Serial.println(" dB");
+    Serial.println();
+
+  }
+
+}
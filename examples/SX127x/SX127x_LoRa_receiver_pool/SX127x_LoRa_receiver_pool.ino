@@ -0,0 +1,93 @@
+#include <SX127x.h>
+#include <LoRaPacketPool.h>
+
+SX127x LoRa;
+
+// Pool of 4 frames received directly from radio FIFO without copying
+LoRaPacketPool<4> Pool;
+
+// Queue of received frames waiting to be printed
+const uint8_t queueSize = 4;
+LoRaFrame* volatile queue[queueSize];
+volatile uint8_t queueHead = 0, queueTail = 0;
+
+void setup() {
+
+  // Begin serial communication
+  Serial.begin(38400);
+
+  // Begin LoRa radio and set NSS, reset, txen, and rxen pin with connected arduino pins
+  Serial.println("Begin LoRa radio");
+  int8_t nssPin = 10, resetPin = 9, irqPin = 2, txenPin = 8, rxenPin = 7;
+  if (!LoRa.begin(nssPin, resetPin, irqPin, txenPin, rxenPin)){
+    Serial.println("Something wrong, can't begin LoRa radio");
+    while(1);
+  }
+
+  // Set frequency to 915 Mhz
+  Serial.println("Set frequency to 915 Mhz");
+  LoRa.setFrequency(915E6);
+
+  // Configure modulation parameter including spreading factor (SF), bandwidth (BW), and coding rate (CR)
+  Serial.println("Set modulation parameters:\n\tSpreading factor = 7\n\tBandwidth = 125 kHz\n\tCoding rate = 4/5");
+  LoRa.setSpreadingFactor(7);
+  LoRa.setBandwidth(125000);
+  LoRa.setCodeRate(5);
+
+  // Configure packet parameter including header type, preamble length, payload length, and CRC type
+  Serial.println("Set packet parameters:\n\tExplicit header type\n\tPreamble length = 12\n\tPayload Length = 15\n\tCRC on");
+  LoRa.setHeaderType(SX127X_HEADER_EXPLICIT);
+  LoRa.setPreambleLength(12);
+  LoRa.setPayloadLength(15);
+  LoRa.setCrcEnable(true);
+
+  // Set syncronize word
+  Serial.println("Set syncronize word to 0x34");
+  LoRa.setSyncWord(0x34);
+
+  Serial.println("\n-- LORA RECEIVER POOL --\n");
+
+  // Receive every packet to frame allocated from pool, packet dropped when pool empty
+  LoRa.onReceive(LoRaPacketPool<4>::provider, getFrame, &Pool);
+
+  // Begin request LoRa packet in continuous mode
+  LoRa.request(SX127X_RX_CONTINUOUS);
+}
+
+void loop() {
+
+  while (queueTail != queueHead) {
+    LoRaFrame* frame = queue[queueTail];
+    queueTail = (queueTail + 1) % queueSize;
+
+    // Print received frame and its status
+    Serial.write(frame->data, frame->length);
+    Serial.print("  RSSI = ");
+    Serial.print(frame->info.rssi);
+    Serial.print(" dBm | SNR = ");
+    Serial.print(frame->info.snr);
+    Serial.println(" dB");
+
+    // Release frame back to pool, call Pool.retain(frame) before passing same frame to other users
+    Pool.release(frame);
+  }
+  Serial.print("Frames available = ");
+  Serial.print(Pool.available());
+  Serial.print(" | allocation failed = ");
+  Serial.println(Pool.allocFailed());
+  delay(1000);
+}
+
+void getFrame(void* context, const uint8_t* data, uint8_t length, const LoRaPacketInfo& info) {
+
+  // Store packet status in frame and add it to queue, release frame when queue full
+  LoRaFrame* frame = Pool.frame(data);
+  frame->info = info;
+  uint8_t next = (queueHead + 1) % queueSize;
+  if (next == queueTail) {
+    Pool.release(frame);
+    return;
+  }
+  queue[queueHead] = frame;
+  queueHead = next;
+}
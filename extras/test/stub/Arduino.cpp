@@ -0,0 +1,136 @@
+#include <Arduino.h>
+#include <SPI.h>
+
+uint64_t stub_time = 0;
+uint32_t stub_tick = 10;
+void (*stub_timeHook)() = NULL;
+uint8_t stub_pinLevel[STUB_PINS];
+uint32_t stub_pinWrites[STUB_PINS];
+void (*stub_isr[STUB_PINS])();
+
+SPIClass SPI;
+
+static StubDevice* stub_devices[STUB_PINS];
+
+void pinMode(int pin, int mode)
+{
+    (void) pin;
+    (void) mode;
+}
+
+void digitalWrite(int pin, int value)
+{
+    if (pin < 0 || pin >= STUB_PINS) return;
+    stub_pinWrites[pin]++;
+    if (value == LOW && stub_pinLevel[pin] != LOW) stub_select(pin);
+    stub_pinLevel[pin] = value;
+}
+
+int digitalRead(int pin)
+{
+    if (pin < 0 || pin >= STUB_PINS) return LOW;
+    return stub_pinLevel[pin];
+}
+
+int digitalPinToInterrupt(int pin)
+{
+    return pin;
+}
+
+void attachInterrupt(int interrupt, void(*isr)(), int mode)
+{
+    (void) mode;
+    if (interrupt >= 0 && interrupt < STUB_PINS) stub_isr[interrupt] = isr;
+}
+
+void detachInterrupt(int interrupt)
+{
+    if (interrupt >= 0 && interrupt < STUB_PINS) stub_isr[interrupt] = NULL;
+}
+
+void noInterrupts() {}
+void interrupts() {}
+
+bool stub_interrupt(int pin)
+{
+    if (pin < 0 || pin >= STUB_PINS || stub_isr[pin] == NULL) return false;
+    stub_isr[pin]();
+    return true;
+}
+
+unsigned long millis()
+{
+    stub_time += stub_tick;
+    if (stub_timeHook) stub_timeHook();
+    return stub_time / 1000;
+}
+
+unsigned long micros()
+{
+    stub_time += stub_tick;
+    if (stub_timeHook) stub_timeHook();
+    return stub_time;
+}
+
+void delay(unsigned long ms)
+{
+    stub_time += (uint64_t) ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    stub_time += us;
+}
+
+void yield() {}
+
+StubDevice::StubDevice(int nss) : nss(nss)
+{
+    stub_devices[nss] = this;
+    stub_pinLevel[nss] = HIGH;
+}
+
+StubDevice::~StubDevice()
+{
+    if (stub_devices[nss] == this) stub_devices[nss] = NULL;
+}
+
+void stub_select(int pin)
+{
+    if (stub_devices[pin]) {
+        stub_devices[pin]->selects++;
+        stub_devices[pin]->select();
+    }
+}
+
+void SPIClass::beginTransaction(SPISettings settings)
+{
+    (void) settings;
+    transactions++;
+    inTransaction = true;
+}
+
+void SPIClass::endTransaction()
+{
+    inTransaction = false;
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+    // byte reach only device which NSS pin low, bus float high otherwise
+    bytes++;
+    uint8_t response = 0xFF;
+    for (int i = 0; i < STUB_PINS; i++) {
+        if (stub_devices[i] && stub_pinLevel[i] == LOW) {
+            stub_devices[i]->transfers++;
+            response = stub_devices[i]->transfer(data);
+        }
+    }
+    return response;
+}
+
+void SPIClass::transfer(void* buf, size_t count)
+{
+    uint8_t* data = (uint8_t*) buf;
+    for (size_t i = 0; i < count; i++) data[i] = transfer(data[i]);
+}
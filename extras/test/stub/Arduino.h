@@ -0,0 +1,48 @@
+#ifndef _STUB_ARDUINO_H_
+#define _STUB_ARDUINO_H_
+
+// Minimal Arduino core for compiling and running the library on host
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH                                    1
+#define LOW                                     0
+#define INPUT                                   0
+#define OUTPUT                                  1
+#define RISING                                  3
+#define STUB_PINS                               64          // number of simulated digital pins
+
+typedef bool boolean;
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+int digitalPinToInterrupt(int pin);
+void attachInterrupt(int interrupt, void(*isr)(), int mode);
+void detachInterrupt(int interrupt);
+void noInterrupts();
+void interrupts();
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// Simulated time advanced on every time read so polling loop with timeout always end
+extern uint64_t stub_time;                                  // current time in microsecond
+extern uint32_t stub_tick;                                  // microseconds added on every millis() and micros() call
+extern void (*stub_timeHook)();                             // called on every time read, e.g. to finish simulated background transfer
+
+// Simulated pin level, pin write count, and attached interrupt handler
+extern uint8_t stub_pinLevel[STUB_PINS];
+extern uint32_t stub_pinWrites[STUB_PINS];
+extern void (*stub_isr[STUB_PINS])();
+
+// Call interrupt handler attached to pin as if rising edge detected, return false when no handler attached
+bool stub_interrupt(int pin);
+
+#endif
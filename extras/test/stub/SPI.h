@@ -0,0 +1,46 @@
+#ifndef _STUB_SPI_H_
+#define _STUB_SPI_H_
+
+#include <Arduino.h>
+
+#define MSBFIRST                                1
+#define SPI_MODE0                               0
+
+struct SPISettings {
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) { (void) clock; (void) bitOrder; (void) dataMode; }
+};
+
+// Simulated device on SPI bus, selected while its NSS pin low
+class StubDevice
+{
+    public:
+        StubDevice(int nss);
+        virtual ~StubDevice();
+        virtual void select() {}
+        virtual uint8_t transfer(uint8_t data) = 0;
+        int nss;
+        uint32_t transfers = 0;                             // bytes exchanged with this device
+        uint32_t selects = 0;                               // chip select windows opened on this device
+};
+
+// SPI bus routing every byte to device which NSS pin low, count transactions and bytes
+class SPIClass
+{
+    public:
+        void begin() {}
+        void end() {}
+        void beginTransaction(SPISettings settings);
+        void endTransaction();
+        uint8_t transfer(uint8_t data);
+        void transfer(void* buf, size_t count);
+        uint32_t transactions = 0;
+        uint32_t bytes = 0;
+        bool inTransaction = false;
+};
+
+extern SPIClass SPI;
+
+// Called by digitalWrite when pin of registered device driven low
+void stub_select(int pin);
+
+#endif
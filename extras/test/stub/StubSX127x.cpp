@@ -0,0 +1,51 @@
+#include <StubSX127x.h>
+
+StubSX127x::StubSX127x(int nss) : StubDevice(nss)
+{
+    memset(reg, 0, sizeof(reg));
+    memset(fifo, 0, sizeof(fifo));
+    memset(regWrites, 0, sizeof(regWrites));
+    reg[0x42] = 0x12;
+}
+
+void StubSX127x::select()
+{
+    _first = true;
+}
+
+uint8_t StubSX127x::transfer(uint8_t data)
+{
+    // first byte of chip select window is address with write bit
+    if (_first) {
+        _first = false;
+        _address = data;
+        return 0x00;
+    }
+    bool write = _address & 0x80;
+    uint8_t address = _address & 0x7F;
+    uint8_t response;
+    if (address == 0x00) {
+        response = write ? 0x00 : fifo[reg[0x0D]];
+        if (write) fifo[reg[0x0D]] = data;
+        reg[0x0D]++;
+    } else {
+        response = reg[address];
+        if (write) {
+            regWrites[address]++;
+            // IRQ flags cleared by writing 1
+            if (address == 0x12) reg[address] &= ~data;
+            else if (address != 0x42) reg[address] = data;
+        }
+        _address = (_address & 0x80) | ((address + 1) & 0x7F);
+    }
+    return response;
+}
+
+void StubSX127x::receive(const uint8_t* data, uint8_t length, uint8_t irqFlags)
+{
+    if (_rxWrite < reg[0x0F]) _rxWrite = reg[0x0F];
+    reg[0x10] = _rxWrite;
+    for (uint8_t i = 0; i < length; i++) fifo[_rxWrite++] = data[i];
+    reg[0x13] = length;
+    reg[0x12] |= irqFlags;
+}
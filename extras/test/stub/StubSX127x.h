@@ -0,0 +1,27 @@
+#ifndef _STUB_SX127X_H_
+#define _STUB_SX127X_H_
+
+#include <SPI.h>
+
+// SX127x register and FIFO model, register address auto increment except for FIFO which follow FIFO address pointer
+class StubSX127x : public StubDevice
+{
+    public:
+        StubSX127x(int nss);
+        void select();
+        uint8_t transfer(uint8_t data);
+
+        // Put received packet in FIFO at RX base address and raise IRQ flags as radio do at RX done
+        void receive(const uint8_t* data, uint8_t length, uint8_t irqFlags=0x40);
+
+        uint8_t reg[128];
+        uint8_t fifo[256];
+        uint32_t regWrites[128];                            // SPI write count of every register
+
+    private:
+        uint8_t _address;
+        bool _first;
+        uint8_t _rxWrite = 0;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdio.h>
+
+// Minimal check macros, test program exit with number of failed checks
+static int test_failed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        test_failed++; \
+    } \
+} while (0)
+
+#define CHECK_EQUAL(a, b) do { \
+    long long a_ = (long long) (a); \
+    long long b_ = (long long) (b); \
+    if (a_ != b_) { \
+        printf("%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, a_, b_); \
+        test_failed++; \
+    } \
+} while (0)
+
+#define TEST_END() do { \
+    printf("%s: %s\n", __FILE__, test_failed ? "FAILED" : "passed"); \
+    return test_failed; \
+} while (0)
+
+#endif
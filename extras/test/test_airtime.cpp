@@ -0,0 +1,68 @@
+// Constexpr time on air against Semtech formula and known airtime from Semtech LoRa calculator
+
+#include <SX127x.h>
+#include <StubSX127x.h>
+#include <math.h>
+#include "test.h"
+
+StubSX127x device(10);
+
+// Airtime in microsecond as given by Semtech calculator, explicit header, CRC on, CR 4/5, 8 symbols preamble
+static_assert(lora_timeOnAir(7, 125000, 5, false, false, 8, true, 10) == 41216, "SF7 BW125 10 bytes");
+static_assert(lora_timeOnAir(12, 125000, 5, true, false, 8, true, 51) == 2465792, "SF12 BW125 51 bytes");
+static_assert(lora_timeOnAir(9, 125000, 5, false, false, 8, true, 20) == 185344, "SF9 BW125 20 bytes");
+static_assert(lora_timeOnAir(7, 250000, 5, false, false, 8, true, 51) == 51328, "SF7 BW250 51 bytes");
+static_assert(lora_symbolTime(10, 125000) == 8192, "SF10 BW125 symbol");
+static_assert(lora_preambleTime(7, 125000, 8) == 12544, "SF7 BW125 preamble");
+
+// Time on air in microsecond from datasheet formula, SX126x SF5 and SF6 use 6.25 symbols preamble overhead and no extra header bits
+double reference(int sf, double bw, int cr, bool ldro, bool implicit, int preamble, bool crc, int length, bool sf56)
+{
+    bool small = sf56 && sf < 7;
+    double symbol = pow(2, sf) / bw * 1e6;
+    double bits = 8.0 * length + (crc ? 16 : 0) - 4.0 * sf + (small ? 0 : 8) + (implicit ? 0 : 20);
+    double payload = 8 + ceil(fmax(bits, 0) / (4.0 * (sf - (ldro ? 2 : 0)))) * cr;
+    return symbol * (preamble + (small ? 6.25 : 4.25) + payload);
+}
+
+int main()
+{
+    const uint32_t bws[] = {62500, 125000, 250000, 500000};
+    uint32_t checked = 0;
+    uint32_t mismatched = 0;
+    for (uint8_t sf = 5; sf <= 12; sf++) {
+        for (uint8_t b = 0; b < 4; b++) {
+            for (uint8_t cr = 5; cr <= 8; cr++) {
+                for (uint8_t flags = 0; flags < 16; flags++) {
+                    bool ldro = flags & 1;
+                    bool implicit = flags & 2;
+                    bool crc = flags & 4;
+                    bool sf56 = flags & 8;
+                    if (ldro && sf < 7) continue;
+                    for (uint16_t length = 0; length <= 255; length += 5) {
+                        uint32_t t = lora_timeOnAir(sf, bws[b], cr, ldro, implicit, 8, crc, length, sf56);
+                        double r = reference(sf, bws[b], cr, ldro, implicit, 8, crc, length, sf56);
+                        // integer result truncated to microsecond
+                        if (t > r + 1e-6 || t + 1 <= r - 1e-6) {
+                            if (mismatched++ < 5) printf("SF%d BW%u CR%d flags %d length %d: %u != %.3f\n", sf, bws[b], cr, flags, length, t, r);
+                        }
+                        checked++;
+                    }
+                }
+            }
+        }
+    }
+    CHECK(checked > 0);
+    CHECK_EQUAL(mismatched, 0);
+
+    // radio object use its current modulation and packet parameters
+    SX127x radio;
+    CHECK(radio.begin(10, -1));
+    radio.setLoRaModulation(7, 125000, 5);
+    radio.setLoRaPacket(SX127X_HEADER_EXPLICIT, 8, 10, true);
+    CHECK_EQUAL(radio.timeOnAir(10), 41216);
+    radio.setLoRaModulation(12, 125000, 5, SX127X_LDRO_AUTO);
+    CHECK_EQUAL(radio.timeOnAir(51), 2465792);
+
+    TEST_END();
+}
@@ -0,0 +1,122 @@
+// Asynchronous transfer with simulated DMA engine finishing in background after fixed time
+
+#include <SX127x.h>
+#include <StubSX127x.h>
+#include "test.h"
+
+#define DMA_TIME                                500         // simulated DMA transfer time in microsecond
+
+StubSX127x device(10);
+
+// Simulated DMA engine, stream bytes on SPI bus when transfer time passed then finish like completion interrupt
+struct Dma {
+    uint8_t* tx;
+    uint8_t* rx;
+    uint16_t length;
+    uint64_t doneTime;
+    bool running;
+    bool stalled;
+    uint32_t started;
+} dma;
+
+bool dmaStart(uint8_t* txBuf, uint8_t* rxBuf, uint16_t length)
+{
+    dma.tx = txBuf;
+    dma.rx = rxBuf;
+    dma.length = length;
+    dma.doneTime = stub_time + DMA_TIME;
+    dma.running = true;
+    dma.started++;
+    return true;
+}
+
+void dmaPoll()
+{
+    if (!dma.running || dma.stalled || stub_time < dma.doneTime) return;
+    dma.running = false;
+    for (uint16_t i = 0; i < dma.length; i++) {
+        uint8_t response = SPI.transfer(dma.tx ? dma.tx[i] : 0x00);
+        if (dma.rx) dma.rx[i] = response;
+    }
+    sx127x_asyncDone();
+}
+
+uint32_t doneCount;
+uint32_t lengthWritesAtDone;
+void onDone()
+{
+    // payload length register must not be written before payload transfer done
+    doneCount++;
+    lengthWritesAtDone = device.regWrites[SX127X_REG_PAYLOAD_LENGTH];
+}
+
+uint32_t rxCount;
+void onRx()
+{
+    rxCount++;
+}
+
+int main()
+{
+    SX127x radio;
+    CHECK(radio.begin(10, -1, 2));
+    radio.setActive();
+    sx127x_setAsyncTransfer(dmaStart);
+    stub_timeHook = dmaPoll;
+
+    // write returns before transfer done and following command waits for it
+    uint8_t message[32];
+    for (uint8_t i = 0; i < sizeof(message); i++) message[i] = 0x30 + i;
+    radio.beginPacket();
+    uint8_t base = device.reg[SX127X_REG_FIFO_TX_BASE_ADDR];
+    uint32_t lengthWrites = device.regWrites[SX127X_REG_PAYLOAD_LENGTH];
+    radio.writeAsync(message, sizeof(message), onDone);
+    CHECK(sx127x_asyncBusy());
+    CHECK_EQUAL(doneCount, 0);
+    CHECK(device.fifo[base] != message[0]);
+    CHECK(radio.endPacket());
+    CHECK_EQUAL(doneCount, 1);
+    CHECK_EQUAL(lengthWritesAtDone, lengthWrites);
+    CHECK(memcmp(device.fifo + base, message, sizeof(message)) == 0);
+    CHECK_EQUAL(device.reg[SX127X_REG_PAYLOAD_LENGTH], sizeof(message));
+    CHECK(!sx127x_asyncBusy());
+
+    // blocking write finished when return so buffer can be reused
+    radio.beginPacket();
+    radio.write(message, sizeof(message));
+    CHECK(!sx127x_asyncBusy());
+    CHECK(memcmp(device.fifo + base, message, sizeof(message)) == 0);
+
+    // interrupt during transfer only flagged, handler run by transfer completion
+    radio.onReceive(onRx);
+    radio.request(SX127X_RX_CONTINUOUS);
+    uint8_t packet[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    uint8_t buffer[16];
+    sx127x_readBurstAsync(SX127X_REG_FIFO, buffer, sizeof(buffer));
+    device.receive(packet, sizeof(packet));
+    CHECK(stub_interrupt(2));
+    CHECK_EQUAL(rxCount, 0);
+    stub_time += DMA_TIME;
+    dmaPoll();
+    CHECK_EQUAL(rxCount, 1);
+    CHECK_EQUAL(radio.available(), sizeof(packet));
+
+    // stalled transfer aborted after timeout, bus released and callback not called
+    dma.stalled = true;
+    doneCount = 0;
+    radio.writeAsync(message, sizeof(message), onDone);
+    uint64_t start = stub_time;
+    CHECK(sx127x_asyncWait());
+    CHECK(stub_time - start >= SX127X_ASYNC_TIMEOUT * 1000UL);
+    CHECK(!sx127x_asyncBusy());
+    CHECK(!SPI.inTransaction);
+    CHECK_EQUAL(stub_pinLevel[10], HIGH);
+    CHECK_EQUAL(doneCount, 0);
+    dma.stalled = false;
+    dma.running = false;
+
+    // next transfer run normally after abort
+    CHECK_EQUAL(sx127x_readRegister(SX127X_REG_VERSION), 0x12);
+
+    TEST_END();
+}
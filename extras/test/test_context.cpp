@@ -0,0 +1,60 @@
+// Two SX127x radios on one SPI bus keep separate context, driver default context follow active object
+
+#include <SX127x.h>
+#include <StubSX127x.h>
+#include "test.h"
+
+StubSX127x deviceA(10);
+StubSX127x deviceB(11);
+
+int main()
+{
+    SX127x radioA;
+    SX127x radioB;
+    CHECK(radioA.begin(10, -1));
+    CHECK(radioB.begin(11, -1));
+
+    // configuration of one radio never reach the other device
+    uint32_t transfersB = deviceB.transfers;
+    radioA.setFrequency(868100000);
+    radioA.setSpreadingFactor(9);
+    CHECK_EQUAL(deviceB.transfers, transfersB);
+    uint32_t transfersA = deviceA.transfers;
+    radioB.setFrequency(433175000);
+    radioB.setSpreadingFactor(7);
+    CHECK_EQUAL(deviceA.transfers, transfersA);
+    CHECK(deviceA.reg[SX127X_REG_FRF_MSB] != deviceB.reg[SX127X_REG_FRF_MSB]);
+    CHECK_EQUAL(deviceA.reg[SX127X_REG_MODEM_CONFIG_2] >> 4, 9);
+    CHECK_EQUAL(deviceB.reg[SX127X_REG_MODEM_CONFIG_2] >> 4, 7);
+
+    // driver functions without context go to active object and share its register shadow
+    radioB.setActive();
+    CHECK(sx127x_activeContext != &sx127x_defaultContext);
+    CHECK_EQUAL(sx127x_activeContext->nss, 11);
+    transfersA = deviceA.transfers;
+    transfersB = deviceB.transfers;
+    sx127x_writeRegister(SX127X_REG_SYNC_WORD, 0x34);
+    CHECK_EQUAL(deviceB.reg[SX127X_REG_SYNC_WORD], 0x34);
+    CHECK_EQUAL(deviceA.transfers, transfersA);
+    transfersB = deviceB.transfers;
+    radioB.setSyncWord(0x34);
+    CHECK_EQUAL(deviceB.transfers, transfersB);
+    radioA.setActive();
+    CHECK_EQUAL(sx127x_activeContext->nss, 10);
+
+    // destroyed active object give default context back
+    {
+        SX127x radioC;
+        radioC.setActive();
+    }
+    CHECK(sx127x_activeContext == &sx127x_defaultContext);
+
+    // begin fails when interrupt pin requested but every interrupt slot taken
+    SX127x radioC;
+    SX127x radioD;
+    SX127x radioE;
+    CHECK(!radioE.begin(11, -1, 3));
+    CHECK(radioE.begin());
+
+    TEST_END();
+}
@@ -0,0 +1,43 @@
+// SX127x write() and read() move whole payload through FIFO in one chip select window
+
+#include <SX127x.h>
+#include <StubSX127x.h>
+#include "test.h"
+
+StubSX127x device(10);
+
+int main()
+{
+    SX127x radio;
+    CHECK(radio.begin(10, -1));
+
+    // write burst
+    uint8_t message[40];
+    for (uint8_t i = 0; i < sizeof(message); i++) message[i] = i + 1;
+    radio.beginPacket();
+    uint32_t selects = device.selects;
+    uint32_t transfers = device.transfers;
+    radio.write(message, sizeof(message));
+    CHECK_EQUAL(device.selects - selects, 1);
+    CHECK_EQUAL(device.transfers - transfers, sizeof(message) + 1);
+    uint8_t base = device.reg[SX127X_REG_FIFO_TX_BASE_ADDR];
+    CHECK(memcmp(device.fifo + base, message, sizeof(message)) == 0);
+    CHECK(radio.endPacket());
+    CHECK_EQUAL(device.reg[SX127X_REG_PAYLOAD_LENGTH], sizeof(message));
+
+    // read burst of received packet
+    uint8_t packet[30];
+    for (uint8_t i = 0; i < sizeof(packet); i++) packet[i] = 0xA0 + i;
+    radio.request();
+    device.receive(packet, sizeof(packet));
+    CHECK(radio.wait(100));
+    CHECK_EQUAL(radio.available(), sizeof(packet));
+    uint8_t data[30];
+    selects = device.selects;
+    CHECK_EQUAL(radio.read(data, sizeof(data)), sizeof(data));
+    CHECK_EQUAL(device.selects - selects, 1);
+    CHECK(memcmp(data, packet, sizeof(packet)) == 0);
+    CHECK_EQUAL(radio.available(), 0);
+
+    TEST_END();
+}
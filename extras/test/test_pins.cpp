@@ -0,0 +1,56 @@
+// NSS and BUSY pin handling of driver on platform without cached port register access
+
+#include <SX126x.h>
+#include <SX127x.h>
+#include <StubSX127x.h>
+#include "test.h"
+
+#define SX126X_NSS                              20
+#define SX126X_BUSY                             21
+
+StubSX127x device(10);
+
+uint64_t busyRelease;
+void busyPoll()
+{
+    if (stub_time >= busyRelease) stub_pinLevel[SX126X_BUSY] = LOW;
+}
+
+int main()
+{
+    // one NSS low and high pair for every register access
+    SX127x radio;
+    CHECK(radio.begin(10, -1));
+    radio.setActive();
+    uint32_t writes = stub_pinWrites[10];
+    CHECK_EQUAL(sx127x_readRegister(SX127X_REG_VERSION), 0x12);
+    CHECK_EQUAL(stub_pinWrites[10] - writes, 2);
+    CHECK_EQUAL(stub_pinLevel[10], HIGH);
+
+    // SX126x command wait until BUSY pin low
+    SX126x radio2;
+    radio2.setPins(SX126X_NSS, -1, SX126X_BUSY);
+    sx126x_context* ctx = sx126x_activeContext;
+    radio2.setActive();
+    sx126x_begin();
+    stub_pinLevel[SX126X_BUSY] = HIGH;
+    busyRelease = stub_time + 2000;
+    stub_timeHook = busyPoll;
+    writes = stub_pinWrites[SX126X_NSS];
+    sx126x_setStandby(SX126X_STANDBY_RC);
+    CHECK(stub_time >= busyRelease);
+    CHECK_EQUAL(stub_pinWrites[SX126X_NSS] - writes, 2);
+
+    // command dropped when BUSY pin stay high until timeout
+    stub_timeHook = NULL;
+    stub_pinLevel[SX126X_BUSY] = HIGH;
+    writes = stub_pinWrites[SX126X_NSS];
+    CHECK(sx126x_busyCheck(10));
+    sx126x_setStandby(SX126X_STANDBY_RC);
+    CHECK_EQUAL(stub_pinWrites[SX126X_NSS] - writes, 0);
+    stub_pinLevel[SX126X_BUSY] = LOW;
+    CHECK(!sx126x_busyCheck(10));
+    sx126x_activeContext = ctx;
+
+    TEST_END();
+}
@@ -0,0 +1,79 @@
+// Fixed block frame pool with reference count, used directly and as buffer provider of packet handler
+
+#include <SX127x.h>
+#include <LoRaPacketPool.h>
+#include <StubSX127x.h>
+#include "test.h"
+
+StubSX127x device(10);
+LoRaPacketPool<3> pool;
+LoRaFrame* held[4];
+uint8_t heldCount;
+
+void handler(void* context, const uint8_t* data, uint8_t length, const LoRaPacketInfo& info)
+{
+    // keep frame after handler return, released later by main loop
+    LoRaFrame* frame = ((LoRaPacketPool<3>*) context)->frame(data);
+    frame->info = info;
+    held[heldCount++] = frame;
+    (void) length;
+}
+
+int main()
+{
+    // allocation until empty then fail and count
+    CHECK_EQUAL(pool.capacity(), 3);
+    CHECK_EQUAL(pool.available(), 3);
+    LoRaFrame* a = pool.alloc();
+    LoRaFrame* b = pool.alloc();
+    LoRaFrame* c = pool.alloc();
+    CHECK(a && b && c && a != b && b != c && a != c);
+    CHECK_EQUAL(a->refCount, 1);
+    CHECK_EQUAL(pool.available(), 0);
+    CHECK(pool.alloc() == NULL);
+    CHECK_EQUAL(pool.allocFailed(), 1);
+
+    // frame back to pool only when last reference released
+    pool.retain(b);
+    CHECK_EQUAL(b->refCount, 2);
+    pool.release(b);
+    CHECK_EQUAL(pool.available(), 0);
+    pool.release(b);
+    CHECK_EQUAL(pool.available(), 1);
+    pool.release(b);
+    CHECK_EQUAL(pool.available(), 1);
+    CHECK(pool.alloc() == b);
+    pool.release(a);
+    pool.release(b);
+    pool.release(c);
+    CHECK_EQUAL(pool.available(), 3);
+
+    // frame found back from data pointer
+    LoRaFrame* d = pool.alloc();
+    CHECK(pool.frame(d->data) == d);
+    pool.release(d);
+
+    // received packets delivered in pool frames, packet not delivered when pool empty
+    SX127x radio;
+    CHECK(radio.begin(10, -1));
+    radio.onReceive(LoRaPacketPool<3>::provider, handler, &pool);
+    uint8_t packet[5] = {0xA1, 0xA2, 0xA3, 0xA4, 0xA5};
+    for (uint8_t i = 0; i < 4; i++) {
+        packet[0] = 0xA1 + i;
+        radio.request();
+        device.receive(packet, sizeof(packet));
+        CHECK(radio.wait(100));
+    }
+    CHECK_EQUAL(heldCount, 3);
+    CHECK_EQUAL(pool.available(), 0);
+    CHECK_EQUAL(pool.allocFailed(), 2);
+    CHECK_EQUAL(held[0]->length, sizeof(packet));
+    CHECK_EQUAL(held[0]->data[0], 0xA1);
+    CHECK_EQUAL(held[2]->data[0], 0xA3);
+    CHECK_EQUAL(held[2]->data[4], 0xA5);
+    CHECK_EQUAL(held[1]->info.length, sizeof(packet));
+    for (uint8_t i = 0; i < heldCount; i++) pool.release(held[i]);
+    CHECK_EQUAL(pool.available(), 3);
+
+    TEST_END();
+}
@@ -0,0 +1,85 @@
+// Packet pool ring filled by interrupt handler in RX continuous operation and drained by readPacket()
+
+#include <SX127x.h>
+#include <StubSX127x.h>
+#include "test.h"
+
+StubSX127x device(10);
+SX127x radio;
+
+void receive(uint8_t first, uint8_t length, uint8_t irqFlags=SX127X_IRQ_RX_DONE)
+{
+    uint8_t data[255];
+    for (uint16_t i = 0; i < length; i++) data[i] = first + i;
+    device.receive(data, length, irqFlags);
+    stub_interrupt(2);
+}
+
+uint8_t handled[255];
+uint8_t handledLength;
+uint8_t* provider(void* context, uint8_t length)
+{
+    (void) context;
+    (void) length;
+    return handled;
+}
+
+void handler(void* context, const uint8_t* data, uint8_t length, const LoRaPacketInfo& info)
+{
+    (void) context;
+    (void) data;
+    (void) info;
+    handledLength = length;
+}
+
+int main()
+{
+    LoRaPacket pool[4];
+    LoRaPacket packet;
+    CHECK(radio.begin(10, -1, 2));
+    CHECK_EQUAL(radio.packetsAvailable(), 0);
+    CHECK(!radio.readPacket(&packet));
+    radio.setPacketPool(pool, 4);
+    radio.request(SX127X_RX_CONTINUOUS);
+
+    // packets read back in receive order with full payload
+    receive(0x10, 255);
+    receive(0x20, 3);
+    CHECK_EQUAL(radio.packetsAvailable(), 2);
+    CHECK(radio.readPacket(&packet));
+    CHECK_EQUAL(packet.length, 255);
+    CHECK_EQUAL(packet.data[0], 0x10);
+    CHECK_EQUAL(packet.data[254], (uint8_t) (0x10 + 254));
+    CHECK_EQUAL(packet.irqStatus, SX127X_IRQ_RX_DONE);
+    CHECK(radio.readPacket(&packet));
+    CHECK_EQUAL(packet.length, 3);
+    CHECK_EQUAL(packet.data[2], 0x22);
+    CHECK(!radio.readPacket(&packet));
+
+    // corrupted packet not stored
+    receive(0x30, 8, SX127X_IRQ_RX_DONE | SX127X_IRQ_CRC_ERR);
+    CHECK_EQUAL(radio.packetsAvailable(), 0);
+    CHECK_EQUAL(radio.packetsDropped(), 0);
+
+    // one slot kept empty, packet dropped and counted when pool full
+    for (uint8_t i = 0; i < 4; i++) receive(0x40 + i, 4);
+    CHECK_EQUAL(radio.packetsAvailable(), 3);
+    CHECK_EQUAL(radio.packetsDropped(), 1);
+    for (uint8_t i = 0; i < 3; i++) {
+        CHECK(radio.readPacket(&packet));
+        CHECK_EQUAL(packet.data[0], 0x40 + i);
+    }
+    CHECK_EQUAL(radio.packetsAvailable(), 0);
+
+    // packet delivered to both pool and packet handler when both registered
+    radio.onReceive(provider, handler);
+    receive(0x50, 12);
+    CHECK_EQUAL(handledLength, 12);
+    CHECK_EQUAL(handled[0], 0x50);
+    CHECK_EQUAL(handled[11], 0x5B);
+    CHECK(radio.readPacket(&packet));
+    CHECK_EQUAL(packet.length, 12);
+    CHECK_EQUAL(packet.data[11], 0x5B);
+
+    TEST_END();
+}
@@ -0,0 +1,157 @@
+// Capture probability of LoRaScanner against simulated radio receiving random traffic over scanned channels
+
+#include <LoRaScanner.h>
+#include "test.h"
+
+#define BANDWIDTH                               125000
+#define PREAMBLE                                8
+#define PACKETS                                 2000
+
+// Deterministic random generator so result reproducible
+static uint32_t seed = 12345;
+uint32_t rnd(uint32_t range)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % range;
+}
+
+// Radio with simulated clock, one packet on air at a time, CAD detect packet when whole CAD inside its preamble
+class SimRadio
+{
+    public:
+
+        static constexpr uint32_t channelWord(uint32_t frequency)
+        {
+            return frequency;
+        }
+
+        void setBandwidth(uint32_t bw) { (void) bw; }
+        void setChannel(uint32_t channel) { _channel = channel; retunes++; }
+        void setSpreadingFactor(uint8_t sf) { _sf = sf; }
+        void setLdroEnable(bool ldro) { (void) ldro; }
+
+        bool cad()
+        {
+            now += LORA_SCANNER_HOP_TIME;
+            _cadStart = now;
+            _waitCad = true;
+            return true;
+        }
+
+        bool wait(uint32_t timeout=0)
+        {
+            if (_waitCad) {
+                now += LoRaScanner<SimRadio>::cadTime(_sf, BANDWIDTH);
+                _waitCad = false;
+                _status = _onChannel() && _cadStart >= start && now <= start + _preamble() ? LORA_STATUS_CAD_DETECTED : LORA_STATUS_CAD_DONE;
+                return true;
+            }
+            // receive finish at packet end when locked before preamble end or at timeout
+            uint64_t until = now + (uint64_t) timeout * 1000;
+            uint64_t finish = _captured ? end : _rxTimeout;
+            now = until < finish ? until : finish;
+            if (now < finish) return false;
+            _status = _captured ? LORA_STATUS_RX_DONE : LORA_STATUS_RX_TIMEOUT;
+            return true;
+        }
+
+        void request(uint32_t timeout)
+        {
+            _captured = _onChannel() && now < start + _preamble();
+            _rxTimeout = now + (uint64_t) timeout * 1000;
+        }
+
+        uint8_t status()
+        {
+            return _status;
+        }
+
+        // Packet currently on air
+        uint64_t now = 0;
+        uint64_t start = 0;
+        uint64_t end = 0;
+        uint32_t frequency = 0;
+        uint8_t sf = 0;
+        uint32_t retunes = 0;
+
+    private:
+
+        uint32_t _channel = 0;
+        uint8_t _sf = 0;
+        bool _waitCad = false;
+        bool _captured = false;
+        uint8_t _status = 0;
+        uint64_t _cadStart = 0;
+        uint64_t _rxTimeout = 0;
+
+        bool _onChannel()
+        {
+            return _channel == frequency && _sf == sf;
+        }
+
+        uint32_t _preamble()
+        {
+            return lora_preambleTime(sf, BANDWIDTH, PREAMBLE);
+        }
+
+};
+
+struct Channel {
+    uint32_t frequency;
+    uint8_t sf;
+};
+
+// Send packets one after another with random gap on random scanned channel, return fraction captured by scanner
+float capture(const Channel* channels, uint8_t count, bool* fits)
+{
+    SimRadio radio;
+    LoRaScanner<SimRadio> scanner(radio, BANDWIDTH, PREAMBLE);
+    for (uint8_t i = 0; i < count; i++) scanner.addChannel(channels[i].frequency, channels[i].sf);
+    *fits = scanner.fitsPreamble();
+
+    uint32_t captured = 0;
+    for (uint32_t p = 0; p < PACKETS; p++) {
+        const Channel* ch = &channels[rnd(count)];
+        radio.start = radio.now + rnd(50000);
+        radio.frequency = ch->frequency;
+        radio.sf = ch->sf;
+        radio.end = radio.start + lora_timeOnAir(ch->sf, BANDWIDTH, 5, false, false, PREAMBLE, true, 20);
+        // receive locked on packet finish exactly at packet end so scan until then
+        bool got = false;
+        while (radio.now < radio.end) {
+            if (scanner.scan()) got = scanner.frequency() == ch->frequency && scanner.spreadingFactor() == ch->sf;
+        }
+        if (got) captured++;
+    }
+    return (float) captured / PACKETS;
+}
+
+int main()
+{
+    // three channels at SF7 fit in 8 symbols preamble, every packet captured
+    const Channel fast[] = {{868100000, 7}, {868300000, 7}, {868500000, 7}};
+    bool fits;
+    float p = capture(fast, 3, &fits);
+    printf("3 channels SF7: fits preamble %d, capture %.3f\n", fits, p);
+    CHECK(fits);
+    CHECK(p >= 0.99);
+
+    // eight channels over several SF too long for SF7 preamble, some packets missed
+    const Channel wide[] = {
+        {868100000, 7}, {868100000, 9}, {868300000, 7}, {868300000, 9},
+        {868500000, 7}, {868500000, 9}, {867100000, 7}, {867300000, 8}
+    };
+    float q = capture(wide, 8, &fits);
+    printf("8 channels SF7-9: fits preamble %d, capture %.3f\n", fits, q);
+    CHECK(!fits);
+    CHECK(q < p);
+
+    // channels sorted by frequency so same frequency with different SF not retuned within cycle
+    SimRadio radio;
+    LoRaScanner<SimRadio> scanner(radio, BANDWIDTH, PREAMBLE);
+    for (uint8_t i = 0; i < 8; i++) scanner.addChannel(wide[i].frequency, wide[i].sf);
+    for (uint8_t i = 0; i < 8; i++) scanner.scan();
+    CHECK_EQUAL(radio.retunes, 5);
+
+    TEST_END();
+}
@@ -35,6 +35,89 @@
 #define LORA_STATUS_CAD_DETECTED                11
 #define LORA_STATUS_CAD_DONE                    12
 
+// Received packet stored in packet pool, slot hold the largest LoRa payload so no packet truncated
+#define LORA_PACKET_LENGTH                      255         // maximum payload bytes kept for each packet in packet pool
+
+struct LoRaPacket {
+    uint8_t data[LORA_PACKET_LENGTH];
+    uint8_t length;
+    int16_t rssi;
+    float snr;
+    uint16_t irqStatus;
+    uint32_t timestamp;                                     // receive time in microsecond
+};
+
+// Byte order of put and get methods
+#define LORA_LITTLE_ENDIAN                      0           // least significant byte first
+#define LORA_BIG_ENDIAN                         1           // most significant byte first
+
+inline void lora_byteOrder(uint8_t* data, uint8_t length, uint8_t endian)
+{
+    // reverse bytes when requested byte order different from host byte order
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if (endian == LORA_BIG_ENDIAN) return;
+#else
+    if (endian == LORA_LITTLE_ENDIAN) return;
+#endif
+    for (uint8_t i=0; i<length/2; i++) {
+        uint8_t b = data[i];
+        data[i] = data[length-1-i];
+        data[length-1-i] = b;
+    }
+}
+
+// Part of packet written with writev, e.g. header and payload from separate buffers
+struct LoRaSegment {
+    const uint8_t* data;
+    uint8_t length;
+};
+
+// Status of last received packet
+struct LoRaPacketInfo {
+    uint8_t length;
+    int16_t rssi;
+    float snr;
+    int16_t signalRssi;
+    int32_t freqError;                                      // frequency error in Hz, 0 when not supported
+    uint16_t irqStatus;
+    uint32_t timestamp;                                     // receive time in microsecond
+};
+
+// Receive handler functions, provider return buffer for received payload length or NULL to drop packet
+typedef uint8_t* (*LoRaBufferProvider)(void* context, uint8_t length);
+typedef void (*LoRaPacketHandler)(void* context, const uint8_t* data, uint8_t length, const LoRaPacketInfo& info);
+
+// LoRa time on air in microsecond based on Semtech formula, sf56 select SX126x formula for SF5 and SF6
+// cr is code rate denominator (5 - 8), implicit header without header symbols, ldro for low data rate optimize
+constexpr uint32_t lora_symbolTime(uint8_t sf, uint32_t bw)
+{
+    return ((uint64_t) 1000000 << sf) / bw;
+}
+
+constexpr uint32_t lora_preambleTime(uint8_t sf, uint32_t bw, uint16_t preambleLength, bool sf56=false)
+{
+    // preamble length plus 4.25 symbols or 6.25 symbols for SF5 and SF6
+    return (((uint64_t) 1000000 << sf) * (4 * (uint32_t) preambleLength + (sf56 && sf < 7 ? 25 : 17))) / (4 * bw);
+}
+
+constexpr int32_t lora_payloadBits(uint8_t sf, bool implicit, bool crc, uint8_t length, bool sf56)
+{
+    return 8 * (int32_t) length + (crc ? 16 : 0) - 4 * (int32_t) sf + (sf56 && sf < 7 ? 0 : 8) + (implicit ? 0 : 20);
+}
+
+constexpr uint32_t lora_payloadSymbols(uint8_t sf, uint8_t cr, bool ldro, bool implicit, bool crc, uint8_t length, bool sf56=false)
+{
+    // 8 symbols plus ceil(bits / (4 * (SF - 2 * LDRO))) code words of cr symbols
+    return 8 + (lora_payloadBits(sf, implicit, crc, length, sf56) > 0
+        ? (lora_payloadBits(sf, implicit, crc, length, sf56) + 4 * (sf - (ldro ? 2 : 0)) - 1) / (4 * (sf - (ldro ? 2 : 0))) * cr
+        : 0);
+}
+
+constexpr uint32_t lora_timeOnAir(uint8_t sf, uint32_t bw, uint8_t cr, bool ldro, bool implicit, uint16_t preambleLength, bool crc, uint8_t length, bool sf56=false)
+{
+    return (((uint64_t) 1000000 << sf) * (4 * (uint32_t) preambleLength + (sf56 && sf < 7 ? 25 : 17) + 4 * lora_payloadSymbols(sf, cr, ldro, implicit, crc, length, sf56))) / (4 * bw);
+}
+
 // Uncomment one of line below to use one or more LoRa model for a network library
 #define USE_LORA_SX126X
 #define USE_LORA_SX127X
@@ -48,6 +131,7 @@ class BaseLoRa
         virtual bool endPacket(uint32_t timeout);
         virtual void write(uint8_t data);
         virtual void write(uint8_t* data, uint8_t length);
+        virtual void writev(const LoRaSegment* segments, uint8_t count);
 
         virtual bool request(uint32_t timeout);
         virtual uint8_t available();
@@ -0,0 +1,83 @@
+#include <LoRaDutyCycle.h>
+
+LoRaDutyCycle::LoRaDutyCycle(uint32_t (*clock)())
+{
+    // use millis() when no clock function given
+    _clock = clock;
+}
+
+bool LoRaDutyCycle::addBand(uint32_t minFrequency, uint32_t maxFrequency, uint16_t dutyCycle)
+{
+    if (_bandCount >= LORA_DUTY_CYCLE_MAX_BANDS || dutyCycle == 0) return false;
+    Band* band = &_bands[_bandCount++];
+    band->minFrequency = minFrequency;
+    band->maxFrequency = maxFrequency;
+    band->dutyCycle = dutyCycle;
+    band->debt = 0;
+    band->updateTime = _now();
+    return true;
+}
+
+void LoRaDutyCycle::setEU868()
+{
+    // ETSI EN 300 220 sub-bands used by LoRaWAN EU868
+    clear();
+    addBand(863000000, 865000000, LORA_DUTY_CYCLE_0_1);
+    addBand(865000000, 868000000, LORA_DUTY_CYCLE_1);
+    addBand(868000000, 868600000, LORA_DUTY_CYCLE_1);
+    addBand(868700000, 869200000, LORA_DUTY_CYCLE_0_1);
+    addBand(869400000, 869650000, LORA_DUTY_CYCLE_10);
+    addBand(869700000, 870000000, LORA_DUTY_CYCLE_1);
+}
+
+void LoRaDutyCycle::clear()
+{
+    _bandCount = 0;
+}
+
+bool LoRaDutyCycle::allowed(uint32_t frequency)
+{
+    return nextAvailable(frequency) == 0;
+}
+
+void LoRaDutyCycle::record(uint32_t frequency, uint32_t airTime)
+{
+    // band available again after air time divided by duty cycle from transmit start
+    Band* band = _getBand(frequency);
+    if (band == NULL) return;
+    _refresh(band);
+    band->debt += airTime / band->dutyCycle;
+}
+
+uint32_t LoRaDutyCycle::nextAvailable(uint32_t frequency)
+{
+    // get time in millisecond until transmit allowed in sub-band of frequency, frequency outside sub-bands always allowed
+    Band* band = _getBand(frequency);
+    if (band == NULL) return 0;
+    _refresh(band);
+    return band->debt;
+}
+
+void LoRaDutyCycle::_refresh(Band* band)
+{
+    // pay off remaining wait time by time elapsed since last update, idle band stays at zero however long unused
+    uint32_t now = _now();
+    uint32_t elapsed = now - band->updateTime;
+    band->debt = elapsed < band->debt ? band->debt - elapsed : 0;
+    band->updateTime = now;
+}
+
+LoRaDutyCycle::Band* LoRaDutyCycle::_getBand(uint32_t frequency)
+{
+    // frequency 0 when not set yet, not in any sub-band
+    if (frequency == 0) return NULL;
+    for (uint8_t i=0; i<_bandCount; i++) {
+        if (frequency >= _bands[i].minFrequency && frequency < _bands[i].maxFrequency) return &_bands[i];
+    }
+    return NULL;
+}
+
+uint32_t LoRaDutyCycle::_now()
+{
+    return _clock ? _clock() : millis();
+}
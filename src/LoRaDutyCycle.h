@@ -0,0 +1,48 @@
+#ifndef _LORA_DUTY_CYCLE_H_
+#define _LORA_DUTY_CYCLE_H_
+
+#include <Arduino.h>
+
+// Duty cycle configuration
+#define LORA_DUTY_CYCLE_MAX_BANDS               8           // maximum number of sub-band tracked
+#define LORA_DUTY_CYCLE_10                      100         // duty cycle limit in permille: 10 %
+#define LORA_DUTY_CYCLE_1                       10          //                               1 %
+#define LORA_DUTY_CYCLE_0_1                     1           //                               0.1 %
+
+class LoRaDutyCycle
+{
+
+    public:
+
+        LoRaDutyCycle(uint32_t (*clock)()=NULL);
+
+        // Sub-band configuration methods
+        bool addBand(uint32_t minFrequency, uint32_t maxFrequency, uint16_t dutyCycle);
+        void setEU868();
+        void clear();
+
+        // Airtime accounting methods, air time in microsecond and available time in millisecond
+        bool allowed(uint32_t frequency);
+        void record(uint32_t frequency, uint32_t airTime);
+        uint32_t nextAvailable(uint32_t frequency);
+
+    private:
+
+        struct Band {
+            uint32_t minFrequency;
+            uint32_t maxFrequency;
+            uint16_t dutyCycle;
+            uint32_t debt;                                  // remaining wait time in millisecond at update time
+            uint32_t updateTime;
+        };
+        Band _bands[LORA_DUTY_CYCLE_MAX_BANDS];
+        uint8_t _bandCount = 0;
+        uint32_t (*_clock)();
+
+        Band* _getBand(uint32_t frequency);
+        void _refresh(Band* band);
+        uint32_t _now();
+
+};
+
+#endif
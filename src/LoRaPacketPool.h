@@ -0,0 +1,156 @@
+#ifndef _LORA_PACKET_POOL_H_
+#define _LORA_PACKET_POOL_H_
+
+#include <BaseLoRa.h>
+
+// Packet pool configuration
+#define LORA_FRAME_LENGTH                       255         // maximum frame payload length
+#define LORA_POOL_END                           0xFF        // free list end marker
+
+// Fixed size frame block, data placed first so frame found back from data pointer given to packet handler
+struct LoRaFrame {
+    uint8_t data[LORA_FRAME_LENGTH];
+    uint8_t length;
+    LoRaPacketInfo info;
+    volatile uint8_t refCount;
+};
+
+// Fixed block pool of N frames with reference counted handle, safe to use from interrupt handler and main loop
+template <uint8_t N>
+class LoRaPacketPool
+{
+
+    static_assert(N > 0 && N < LORA_POOL_END, "LoRaPacketPool capacity must be 1 - 254 frames");
+
+    public:
+
+        LoRaPacketPool()
+        {
+            for (uint8_t i=0; i<N; i++) {
+                _next[i] = i + 1 < N ? i + 1 : LORA_POOL_END;
+                _frames[i].refCount = 0;
+            }
+        }
+
+        // Allocation methods, frame returned with one reference and released back to pool when last reference released
+        LoRaFrame* alloc()
+        {
+            LoRaFrame* frame = NULL;
+            uint32_t state = _lock();
+            if (_free != LORA_POOL_END) {
+                frame = &_frames[_free];
+                _free = _next[_free];
+                frame->length = 0;
+                frame->refCount = 1;
+                _used++;
+            } else {
+                _failed++;
+            }
+            _unlock(state);
+            return frame;
+        }
+
+        void retain(LoRaFrame* frame)
+        {
+            uint32_t state = _lock();
+            frame->refCount++;
+            _unlock(state);
+        }
+
+        void release(LoRaFrame* frame)
+        {
+            uint32_t state = _lock();
+            if (frame->refCount && --frame->refCount == 0) {
+                uint8_t index = frame - _frames;
+                _next[index] = _free;
+                _free = index;
+                _used--;
+            }
+            _unlock(state);
+        }
+
+        LoRaFrame* frame(const uint8_t* data)
+        {
+            return (LoRaFrame*) data;
+        }
+
+        // Pool status methods
+        uint8_t capacity()
+        {
+            return N;
+        }
+
+        uint8_t available()
+        {
+            return N - _used;
+        }
+
+        uint16_t allocFailed()
+        {
+            return _failed;
+        }
+
+        // Buffer provider for onReceive with pool object as context, handler get frame back with frame(data)
+        static uint8_t* provider(void* context, uint8_t length)
+        {
+            LoRaFrame* frame = ((LoRaPacketPool*) context)->alloc();
+            if (frame == NULL) return NULL;
+            frame->length = length;
+            return frame->data;
+        }
+
+    private:
+
+        LoRaFrame _frames[N];
+        uint8_t _next[N];
+        volatile uint8_t _free = 0;
+        volatile uint8_t _used = 0;
+        volatile uint16_t _failed = 0;
+#if defined(ESP32)
+        portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+        // save interrupt state and disable interrupt so lock can be taken again inside interrupt handler
+        inline uint32_t _lock()
+        {
+#if defined(__AVR__)
+            uint8_t sreg = SREG;
+            cli();
+            return sreg;
+#elif defined(__arm__)
+            uint32_t primask;
+            __asm__ volatile ("mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory");
+            return primask;
+#elif defined(ESP8266)
+            return xt_rsil(15);
+#elif defined(ESP32)
+            // spinlock critical section usable from both task and interrupt handler
+            portENTER_CRITICAL_SAFE(&_mux);
+            return 0;
+#elif !defined(ARDUINO)
+            // host build without interrupt, e.g. host tests
+            return 0;
+#else
+#error "LoRaPacketPool has no interrupt state save and restore for this platform"
+#endif
+        }
+
+        inline void _unlock(uint32_t state)
+        {
+#if defined(__AVR__)
+            SREG = state;
+#elif defined(__arm__)
+            __asm__ volatile ("msr primask, %0" :: "r" (state) : "memory");
+#elif defined(ESP8266)
+            xt_wsr_ps(state);
+#elif defined(ESP32)
+            (void) state;
+            portEXIT_CRITICAL_SAFE(&_mux);
+#else
+            (void) state;
+#endif
+        }
+
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef _LORA_SCANNER_H_
+#define _LORA_SCANNER_H_
+
+#include <BaseLoRa.h>
+
+// Scanner configuration
+#define LORA_SCANNER_MAX_CHANNELS               16          // maximum number of channel and SF pair scanned
+#define LORA_SCANNER_HOP_TIME                   300         // estimated time to retune and start CAD in microsecond
+
+// Single radio CAD scanner for SX126x or SX127x object, cycle CAD across channel and SF pairs then receive where activity detected
+template <class Radio>
+class LoRaScanner
+{
+
+    public:
+
+        LoRaScanner(Radio &radio, uint32_t bw=125000, uint16_t preambleLength=8)
+            : _radio(radio), _bw(bw), _preambleLength(preambleLength)
+        {
+        }
+
+        // Channel configuration methods, channels kept sorted by frequency and SF so retune skipped between same frequency or SF
+        bool addChannel(uint32_t frequency, uint8_t sf)
+        {
+            if (_count >= LORA_SCANNER_MAX_CHANNELS) return false;
+            uint8_t i = _count++;
+            while (i > 0 && (_channels[i-1].frequency > frequency || (_channels[i-1].frequency == frequency && _channels[i-1].sf > sf))) {
+                _channels[i] = _channels[i-1];
+                i--;
+            }
+            _channels[i].frequency = frequency;
+            _channels[i].word = Radio::channelWord(frequency);
+            _channels[i].sf = sf;
+            _index = 0;
+            return true;
+        }
+
+        void clear()
+        {
+            _count = 0;
+            _index = 0;
+            _receiving = false;
+        }
+
+        uint8_t channelCount()
+        {
+            return _count;
+        }
+
+        // Scan method, call repeatedly and read packet from radio object when return true before next call
+        bool scan()
+        {
+            if (_count == 0) return false;
+
+            if (_receiving) {
+                // check receive on locked channel shortly then resume scanning from next channel
+                if (!_radio.wait(1)) return false;
+                _receiving = false;
+                _received = _index;
+                _index = (_index + 1) % _count;
+                return _radio.status() == LORA_STATUS_RX_DONE;
+            }
+
+            // CAD on current channel and lock into receive until end of header when activity detected
+            Channel* ch = &_channels[_index];
+            _tune(ch);
+            if (!_radio.cad()) return false;
+            _radio.wait();
+            if (_radio.status() == LORA_STATUS_CAD_DETECTED) {
+                _radio.request(lora_preambleTime(ch->sf, _bw, _preambleLength) / 1000 + 1);
+                _receiving = true;
+                return false;
+            }
+            _index = (_index + 1) % _count;
+            return false;
+        }
+
+        // Received packet channel methods
+        uint8_t channel()
+        {
+            return _received;
+        }
+
+        uint32_t frequency()
+        {
+            return _channels[_received].frequency;
+        }
+
+        uint8_t spreadingFactor()
+        {
+            return _channels[_received].sf;
+        }
+
+        // Timing methods in microsecond, CAD need 2 symbols below SF9 and 4 symbols otherwise
+        uint32_t cycleTime()
+        {
+            uint32_t t = 0;
+            for (uint8_t i=0; i<_count; i++) t += cadTime(_channels[i].sf, _bw) + LORA_SCANNER_HOP_TIME;
+            return t;
+        }
+
+        static constexpr uint32_t cadTime(uint8_t sf, uint32_t bw)
+        {
+            return lora_symbolTime(sf, bw) * (sf < 9 ? 2 : 4);
+        }
+
+        bool fitsPreamble()
+        {
+            // packet captured on every channel when full cycle plus its CAD shorter than preamble
+            uint32_t cycle = cycleTime();
+            for (uint8_t i=0; i<_count; i++) {
+                if (cycle + cadTime(_channels[i].sf, _bw) > lora_preambleTime(_channels[i].sf, _bw, _preambleLength)) return false;
+            }
+            return true;
+        }
+
+    private:
+
+        struct Channel {
+            uint32_t frequency;
+            uint32_t word;
+            uint8_t sf;
+        };
+        Radio &_radio;
+        uint32_t _bw;
+        uint16_t _preambleLength;
+        Channel _channels[LORA_SCANNER_MAX_CHANNELS];
+        uint8_t _count = 0;
+        uint8_t _index = 0;
+        uint8_t _received = 0;
+        bool _receiving = false;
+        uint32_t _tunedWord = 0;
+        uint8_t _tunedSf = 0;
+        bool _tunedLdro = false;
+
+        void _tune(Channel* ch)
+        {
+            // only send command for parameter different from previous channel
+            bool first = _tunedSf == 0;
+            if (first) _radio.setBandwidth(_bw);
+            if (ch->word != _tunedWord) {
+                _radio.setChannel(ch->word);
+                _tunedWord = ch->word;
+            }
+            if (ch->sf != _tunedSf) {
+                _radio.setSpreadingFactor(ch->sf);
+                _tunedSf = ch->sf;
+                // low data rate optimize needed when symbol time longer than 16 ms
+                bool ldro = lora_symbolTime(ch->sf, _bw) > 16000;
+                if (ldro != _tunedLdro || first) {
+                    _radio.setLdroEnable(ldro);
+                    _tunedLdro = ldro;
+                }
+            }
+        }
+
+};
+
+#endif
@@ -1,45 +1,63 @@
 #include <SX126x.h>
 
-void (*SX126x::_onTransmit)();
+SX126x* SX126x::_instances[SX126X_MAX_INSTANCES];
 
-void (*SX126x::_onReceive)();
-
-uint16_t SX126x::_statusIrq = 0xFFFF;
-
-uint32_t SX126x::_transmitTime = 0;
-
-uint8_t SX126x::_bufferIndex = 0;
-
-uint8_t SX126x::_payloadTxRx = 0;
-
-int8_t SX126x::_irqStatic = -1;
-
-int8_t SX126x::_pinToLow = -1;
+void (*const SX126x::_interrupts[SX126X_MAX_INSTANCES])() = {
+    SX126x::_interrupt0, SX126x::_interrupt1, SX126x::_interrupt2, SX126x::_interrupt3
+};
 
 SX126x::SX126x()
 {
-    _spi = &SX126X_SPI;
+    // register object in instance table so interrupt handler can find its own object
+    _slot = 0xFF;
+    for (uint8_t i=0; i<SX126X_MAX_INSTANCES; i++) {
+        if (_instances[i] == NULL) {
+            _instances[i] = this;
+            _slot = i;
+            break;
+        }
+    }
+    _ctx = sx126x_defaultContext;
     _dio = SX126X_PIN_RF_IRQ;
     setPins(SX126X_PIN_NSS, SX126X_PIN_RESET, SX126X_PIN_BUSY);
 }
 
+SX126x::~SX126x()
+{
+    if (_eventMode) setEventMode(false);
+    if (_slot < SX126X_MAX_INSTANCES) _instances[_slot] = NULL;
+    if (sx126x_activeContext == &_ctx) sx126x_activeContext = &sx126x_defaultContext;
+}
+
 bool SX126x::begin()
 {
+    // interrupt handler not available when all instance slots taken, fail so irq pin not silently ignored
+    // irq pin then cleared so calling begin again use polling operation
+    if (_irq != -1 && _slot >= SX126X_MAX_INSTANCES) {
+        _irq = -1;
+        return false;
+    }
+
     // set pins as input or output
     if (_irq != -1) pinMode(_irq, INPUT);
     if (_txen != -1) pinMode(_txen, OUTPUT);
     if (_rxen != -1) pinMode(_rxen, OUTPUT);
 
     // begin spi and perform device reset
-    sx126x_begin();
+    sx126x_begin(&_ctx);
+    sx126x_onAsyncIdle(_asyncIdle);
     sx126x_reset(_reset);
+    _regCached = false;
+    _calFreq = 0;
 
     // check if device connect and set modem to LoRa
-    sx126x_setStandby(SX126X_STANDBY_RC);
-    if (getMode() != SX126X_STATUS_MODE_STDBY_RC) return false;
-    sx126x_setPacketType(SX126X_LORA_MODEM);
-    
-    sx126x_fixResistanceAntenna();
+    sx126x_setStandby(SX126X_STANDBY_RC, &_ctx);
+    _mode = getMode();
+    if (_mode != SX126X_STATUS_MODE_STDBY_RC) return false;
+    sx126x_setPacketType(SX126X_LORA_MODEM, &_ctx);
+    _modem = SX126X_LORA_MODEM;
+
+    sx126x_fixResistanceAntenna(&_ctx);
     return true;
 }
 
@@ -52,79 +70,99 @@ bool SX126x::begin(int8_t nss, int8_t reset, int8_t busy, int8_t irq, int8_t txe
 void SX126x::end()
 {
     sleep(SX126X_SLEEP_COLD_START);
-    _spi->end();
+    _ctx.spi->end();
 }
 
 bool SX126x::reset()
 {
     // put reset pin to low then wait busy pin to low
     sx126x_reset(_reset);
-    return !sx126x_busyCheck();
+    _regCached = false;
+    _calFreq = 0;
+    return !sx126x_busyCheck(SX126X_BUSY_TIMEOUT, &_ctx);
 }
 
 void SX126x::sleep(uint8_t option)
 {
     // put device in sleep mode, wait for 500 us to enter sleep mode
     standby();
-    sx126x_setSleep(option);
+    sx126x_setSleep(option, &_ctx);
     delayMicroseconds(500);
+    // device mode and register content unknown after sleep
+    _mode = 0;
+    _regCached = false;
+    _calFreq = 0;
 }
 
 void SX126x::wake()
 {
     // wake device by set nss to low and put device in standby mode
-    digitalWrite(_nss, LOW);
+    digitalWrite(_ctx.nss, LOW);
     standby();
-    sx126x_fixResistanceAntenna();
+    sx126x_fixResistanceAntenna(&_ctx);
 }
 
 void SX126x::standby(uint8_t option)
 {
-    sx126x_setStandby(option);
+    sx126x_setStandby(option, &_ctx);
+    _mode = option == SX126X_STANDBY_XOSC ? SX126X_STATUS_MODE_STDBY_XOSC : SX126X_STATUS_MODE_STDBY_RC;
 }
 
 void SX126x::setActive()
 {
-    // override spi, nss, and busy static property in SX126x driver with object property
-    sx126x_setSPI(*_spi, 0);
-    sx126x_setPins(_nss, _busy);
+    // driver functions called without context use this object context
+    sx126x_activeContext = &_ctx;
 }
 
 bool SX126x::busyCheck(uint32_t timeout)
 {
-    return sx126x_busyCheck(timeout);
+    return sx126x_busyCheck(timeout, &_ctx);
 }
 
 void SX126x::setFallbackMode(uint8_t fallbackMode)
 {
-    sx126x_setRxTxFallbackMode(fallbackMode);
+    sx126x_setRxTxFallbackMode(fallbackMode, &_ctx);
+    _fallbackMode = fallbackMode;
 }
 
 uint8_t SX126x::getMode()
 {
     uint8_t mode;
-    sx126x_getStatus(&mode);
+    sx126x_getStatus(&mode, &_ctx);
     return mode & 0x70;
 }
 
-void SX126x::setSPI(SPIClass &SpiObject, uint32_t frequency)
+void SX126x::beginBatch(uint8_t* buffer, uint16_t size)
+{
+    // record configuration commands in buffer to send them at once when batch end
+    // defer DIO interrupt handler while batch open so it not send commands ahead of recorded ones
+    _irqDefer = true;
+    sx126x_beginBatch(buffer, size, &_ctx);
+}
+
+uint32_t SX126x::endBatch()
 {
-    sx126x_setSPI(SpiObject, frequency);
+    // run interrupt handler deferred while batch open after recorded commands sent
+    uint32_t time = sx126x_endBatch(&_ctx);
+    _irqDefer = false;
+    if (!_eventMode) process();
+    return time;
+}
 
-    _spi = &SpiObject;
+void SX126x::setSPI(SPIClass &SpiObject, uint32_t frequency)
+{
+    sx126x_setSPI(SpiObject, frequency, &_ctx);
 }
 
 void SX126x::setPins(int8_t nss, int8_t reset, int8_t busy, int8_t irq, int8_t txen, int8_t rxen)
 {
-    sx126x_setPins(nss, busy);
+    sx126x_setPins(nss, busy, &_ctx);
 
-    _nss = nss;
     _reset = reset;
-    _busy = busy;
     _irq = irq;
     _txen = txen;
     _rxen = rxen;
-    _irqStatic = digitalPinToInterrupt(_irq);
+    _irqNum = digitalPinToInterrupt(_irq);
 }
 
 void SX126x::setRfIrqPin(int8_t dioPinSelect)
@@ -135,73 +173,112 @@ void SX126x::setRfIrqPin(int8_t dioPinSelect)
 
 void SX126x::setDio2RfSwitch(bool enable)
 {
-    if (enable) sx126x_setDio2AsRfSwitchCtrl(SX126X_DIO2_AS_RF_SWITCH);
-    else sx126x_setDio2AsRfSwitchCtrl(SX126X_DIO2_AS_IRQ);
+    if (enable) sx126x_setDio2AsRfSwitchCtrl(SX126X_DIO2_AS_RF_SWITCH, &_ctx);
+    else sx126x_setDio2AsRfSwitchCtrl(SX126X_DIO2_AS_IRQ, &_ctx);
 }
 
 void SX126x::setDio3TcxoCtrl(uint8_t tcxoVoltage, uint32_t delayTime)
 {
-    sx126x_setDio3AsTcxoCtrl(tcxoVoltage, delayTime);
-    sx126x_setStandby(SX126X_STANDBY_RC);
-    sx126x_calibrate(0xFF);
+    sx126x_setDio3AsTcxoCtrl(tcxoVoltage, delayTime, &_ctx);
+    sx126x_setStandby(SX126X_STANDBY_RC, &_ctx);
+    sx126x_calibrate(0xFF, &_ctx);
+    // full calibration reset image calibration to default band
+    _calFreq = 0;
 }
 
 void SX126x::setXtalCap(uint8_t xtalA, uint8_t xtalB)
 {
-    sx126x_setStandby(SX126X_STANDBY_XOSC);
+    sx126x_setStandby(SX126X_STANDBY_XOSC, &_ctx);
     uint8_t buf[2] = {xtalA, xtalB};
-    sx126x_writeRegister(SX126X_REG_XTA_TRIM, buf, 2);
-    sx126x_setStandby(SX126X_STANDBY_RC);
-    sx126x_calibrate(0xFF);
+    sx126x_writeRegister(SX126X_REG_XTA_TRIM, buf, 2, &_ctx);
+    sx126x_setStandby(SX126X_STANDBY_RC, &_ctx);
+    sx126x_calibrate(0xFF, &_ctx);
+    // full calibration reset image calibration to default band
+    _calFreq = 0;
 }
 
 void SX126x::setRegulator(uint8_t regMode)
 {
-    sx126x_setRegulatorMode(regMode);
+    sx126x_setRegulatorMode(regMode, &_ctx);
 }
 
 void SX126x::setCurrentProtection(uint8_t current)
 {
     uint8_t currentmA = current * 2 / 5;
-    sx126x_writeRegister(SX126X_REG_OCP_CONFIGURATION, &currentmA, 1);
+    sx126x_writeRegister(SX126X_REG_OCP_CONFIGURATION, &currentmA, 1, &_ctx);
 }
 
 void SX126x::setModem(uint8_t modem)
 {
     _modem = modem;
-    sx126x_setStandby(SX126X_STANDBY_RC);
-    sx126x_setPacketType(modem);
+    sx126x_setStandby(SX126X_STANDBY_RC, &_ctx);
+    sx126x_setPacketType(modem, &_ctx);
 }
 
 void SX126x::setFrequency(uint32_t frequency)
 {
+    // calculate frequency for setting configuration
+    setChannel(channelWord(frequency));
+}
+
+void SX126x::setChannel(uint32_t channel)
+{
+    // frequency only needed for duty cycle accounting so multiply instead of divide
+    _frequency = ((uint64_t) channel * SX126X_RF_FREQUENCY_XTAL) >> SX126X_RF_FREQUENCY_SHIFT;
+
+    // select image calibration band by comparing with channel word of band limit
     uint8_t calFreq[2];
-    if (frequency < 446000000) {        // 430 - 440 Mhz
+    if (channel < channelWord(446000000)) {         // 430 - 440 Mhz
         calFreq[0] = SX126X_CAL_IMG_430;
         calFreq[1] = SX126X_CAL_IMG_440;
     }
-    else if (frequency < 734000000) {   // 470 - 510 Mhz
+    else if (channel < channelWord(734000000)) {    // 470 - 510 Mhz
         calFreq[0] = SX126X_CAL_IMG_470;
         calFreq[1] = SX126X_CAL_IMG_510;
     }
-    else if (frequency < 828000000) {   // 779 - 787 Mhz
+    else if (channel < channelWord(828000000)) {    // 779 - 787 Mhz
         calFreq[0] = SX126X_CAL_IMG_779;
         calFreq[1] = SX126X_CAL_IMG_787;
     }
-    else if (frequency < 877000000) {   // 863 - 870 Mhz
+    else if (channel < channelWord(877000000)) {    // 863 - 870 Mhz
         calFreq[0] = SX126X_CAL_IMG_863;
         calFreq[1] = SX126X_CAL_IMG_870;
     }
-    else if (frequency < 1100000000) {  // 902 - 928 Mhz
+    else {                                          // 902 - 928 Mhz
         calFreq[0] = SX126X_CAL_IMG_902;
         calFreq[1] = SX126X_CAL_IMG_928;
     }
-    // calculate frequency for setting configuration
-    uint32_t rfFreq = ((uint64_t) frequency << SX126X_RF_FREQUENCY_SHIFT) / SX126X_RF_FREQUENCY_XTAL;
 
-    // perform image calibration before set frequency
-    sx126x_calibrateImage(calFreq[0], calFreq[1]);
-    sx126x_setRfFrequency(rfFreq);
+    // perform image calibration before set frequency only when band changed
+    if (calFreq[0] != _calFreq) {
+        sx126x_calibrateImage(calFreq[0], calFreq[1], &_ctx);
+        _calFreq = calFreq[0];
+    }
+    sx126x_setRfFrequency(channel, &_ctx);
+}
+
+void SX126x::setHopTable(const uint32_t* channels, uint8_t count)
+{
+    // channels is array of precomputed channel word, must be kept while used
+    _hopTable = channels;
+    _hopCount = count;
+    _hopIndex = 0;
+}
+
+uint8_t SX126x::hop()
+{
+    // move to next channel in hop table
+    if (_hopCount == 0) return 0;
+    _hopIndex = _hopIndex + 1 < _hopCount ? _hopIndex + 1 : 0;
+    setChannel(_hopTable[_hopIndex]);
+    return _hopIndex;
+}
+
+void SX126x::hop(uint8_t index)
+{
+    if (index >= _hopCount) return;
+    _hopIndex = index;
+    setChannel(_hopTable[_hopIndex]);
 }
 
 void SX126x::setTxPower(uint8_t txPower, uint8_t version)
@@ -252,19 +329,19 @@ void SX126x::setTxPower(uint8_t txPower, uint8_t version)
     }
 
     // set power amplifier and TX power configuration
-    sx126x_setPaConfig(paDutyCycle, hpMax, deviceSel, 0x01);
-    sx126x_setTxParams(power, SX126X_PA_RAMP_800U);
+    sx126x_setPaConfig(paDutyCycle, hpMax, deviceSel, 0x01, &_ctx);
+    sx126x_setTxParams(power, SX126X_PA_RAMP_800U, &_ctx);
 }
 
 void SX126x::setRxGain(uint8_t boost)
 {
     // set power saving or boosted gain in register
     uint8_t gain = boost ? SX126X_BOOSTED_GAIN : SX126X_POWER_SAVING_GAIN;
-    sx126x_writeRegister(SX126X_REG_RX_GAIN, &gain, 1);
+    sx126x_writeRegister(SX126X_REG_RX_GAIN, &gain, 1, &_ctx);
     if (boost){
         // set certain register to retain configuration after wake from sleep mode
         uint8_t buf[3] = {0x01, 0x08, 0xAC};
-        sx126x_writeRegister(0x029F, buf, 3);
+        sx126x_writeRegister(0x029F, buf, 3, &_ctx);
     }
 }
 
@@ -293,7 +370,7 @@ void SX126x::setLoRaModulation(uint8_t sf, uint32_t bw, uint8_t cr, bool ldro)
     cr -= 4;
     if (cr > 4) cr = 0;
 
-    sx126x_setModulationParamsLoRa(sf, (uint8_t) bw, cr, (uint8_t) ldro);
+    sx126x_setModulationParamsLoRa(sf, (uint8_t) bw, cr, (uint8_t) ldro, &_ctx);
 }
 
 void SX126x::setLoRaPacket(uint8_t headerType, uint16_t preambleLength, uint8_t payloadLength, bool crcType, bool invertIq)
@@ -307,8 +384,8 @@ void SX126x::setLoRaPacket(uint8_t headerType, uint16_t preambleLength, uint8_t
     // filter valid header type config
     if (headerType != SX126X_HEADER_IMPLICIT) headerType = SX126X_HEADER_EXPLICIT;
 
-    sx126x_setPacketParamsLoRa(preambleLength, headerType, payloadLength, (uint8_t) crcType, (uint8_t) invertIq);
-    sx126x_fixInvertedIq((uint8_t) invertIq);
+    sx126x_setPacketParamsLoRa(preambleLength, headerType, payloadLength, (uint8_t) crcType, (uint8_t) invertIq, &_ctx);
+    _fixInvertedIq();
 }
 
 void SX126x::setSpreadingFactor(uint8_t sf)
@@ -365,28 +442,28 @@ void SX126x::setSyncWord(uint16_t syncWord)
         buf[0] = (syncWord & 0xF0) | 0x04;
         buf[1] = (syncWord << 4) | 0x04;
     }
-    sx126x_writeRegister(SX126X_REG_LORA_SYNC_WORD_MSB, buf, 2);
+    sx126x_writeRegister(SX126X_REG_LORA_SYNC_WORD_MSB, buf, 2, &_ctx);
 }
 
 void SX126x::setFskModulation(uint32_t br, uint8_t pulseShape, uint8_t bandwidth, uint32_t Fdev)
 {
-    sx126x_setModulationParamsFSK(br, pulseShape, bandwidth, Fdev);
+    sx126x_setModulationParamsFSK(br, pulseShape, bandwidth, Fdev, &_ctx);
 }
 
 void SX126x::setFskPacket(uint16_t preambleLength, uint8_t preambleDetector, uint8_t syncWordLength, uint8_t addrComp, uint8_t packetType, uint8_t payloadLength, uint8_t crcType, uint8_t whitening)
 {
-    sx126x_setPacketParamsFSK(preambleLength, preambleDetector, syncWordLength, addrComp, packetType, payloadLength, crcType, whitening);
+    sx126x_setPacketParamsFSK(preambleLength, preambleDetector, syncWordLength, addrComp, packetType, payloadLength, crcType, whitening, &_ctx);
 }
 
 void SX126x::setFskSyncWord(uint8_t* sw, uint8_t swLen)
 {
-    sx126x_writeRegister(SX126X_REG_FSK_SYNC_WORD_0, sw, swLen);
+    sx126x_writeRegister(SX126X_REG_FSK_SYNC_WORD_0, sw, swLen, &_ctx);
 }
 
 void SX126x::setFskAdress(uint8_t nodeAddr, uint8_t broadcastAddr)
 {
     uint8_t buf[2] = {nodeAddr, broadcastAddr};
-    sx126x_writeRegister(SX126X_REG_FSK_NODE_ADDRESS, buf, 2);
+    sx126x_writeRegister(SX126X_REG_FSK_NODE_ADDRESS, buf, 2, &_ctx);
 }
 
 void SX126x::setFskCrc(uint16_t crcInit, uint16_t crcPolynom)
@@ -396,7 +473,7 @@ void SX126x::setFskCrc(uint16_t crcInit, uint16_t crcPolynom)
     buf[1] = crcInit & 0xFF;
     buf[2] = crcPolynom >> 8;
     buf[3] = crcPolynom & 0xFF;
-    sx126x_writeRegister(SX126X_REG_FSK_CRC_INITIAL_MSB, buf, 4);
+    sx126x_writeRegister(SX126X_REG_FSK_CRC_INITIAL_MSB, buf, 4, &_ctx);
 }
 
 void SX126x::setFskWhitening(uint16_t whitening)
@@ -404,14 +481,15 @@ void SX126x::setFskWhitening(uint16_t whitening)
     uint8_t buf[2];
     buf[0] = whitening >> 8;
     buf[1] = whitening & 0xFF;
-    sx126x_writeRegister(SX126X_REG_FSK_WHITENING_INITIAL_MSB, buf, 2);
+    sx126x_writeRegister(SX126X_REG_FSK_WHITENING_INITIAL_MSB, buf, 2, &_ctx);
 }
 
 void SX126x::beginPacket()
 {
     // reset payload length and buffer index
     _payloadTxRx = 0;
-    sx126x_setBufferBaseAddress(_bufferIndex, _bufferIndex + 0xFF);
+    _stageLen = 0;
+    sx126x_setBufferBaseAddress(_bufferIndex, _bufferIndex + 0xFF, &_ctx);
 
     // set txen pin to low and rxen pin to high
     if ((_rxen != -1) && (_txen != -1)) {
@@ -419,14 +497,24 @@ void SX126x::beginPacket()
         digitalWrite(_txen, HIGH);
         _pinToLow = _txen;
     }
-    
-    sx126x_fixLoRaBw500(_bw);
+
+    _fixLoRaBw500();
 }
 
 bool SX126x::endPacket(uint32_t timeout)
 {
     // skip to enter TX mode when previous TX operation incomplete
-    if (getMode() == SX126X_STATUS_MODE_TX) return false;
+    if (_getMode() == SX126X_STATUS_MODE_TX) return false;
+    // skip to enter TX mode when duty cycle limit of sub-band reached
+    if (_dutyCycle) {
+        if (!_dutyCycle->allowed(_frequency)) return false;
+    }
+    // skip to enter TX mode when channel still busy after listen before talk attempts, not run inside interrupt handler
+    if (_lbtAttempts && !_inInterrupt) {
+        if (!_channelClear()) return false;
+    }
+    // write staged packet to radio in single transfer
+    if (_stageLen) _stageFlush();
 
     // clear previous interrupt and set TX done, and TX timeout as interrupt source
     _irqSetup(SX126X_IRQ_TX_DONE | SX126X_IRQ_TIMEOUT);
@@ -442,28 +530,98 @@ bool SX126x::endPacket(uint32_t timeout)
     if (txTimeout > 0x00FFFFFF) txTimeout = SX126X_TX_SINGLE;
 
     // set device to transmit mode with configured timeout or single operation
-    sx126x_setTx(txTimeout);
+    sx126x_setTx(txTimeout, &_ctx);
+    _mode = SX126X_STATUS_MODE_TX;
     _transmitTime = millis();
+    _waitStart = micros();
+    uint32_t airTime = timeOnAir(_payloadTxRx);
+    if (_dutyCycle) _dutyCycle->record(_frequency, airTime);
+    // polling wait start checking IRQ status shortly before expected transmit finish
+    _waitExpected = _modem == SX126X_LORA_MODEM ? airTime - (airTime >> 4) : 0;
 
     // set operation status to wait and attach TX interrupt handler
-    if (_irq != -1) {
-        attachInterrupt(_irqStatic, SX126x::_interruptTx, RISING);
+    if (_irq != -1 && !_eventMode) {
+        attachInterrupt(_irqNum, _interrupts[_slot], RISING);
     }
     return true;
 }
 
+void SX126x::setListenBeforeTalk(uint8_t attempts, uint32_t backoff)
+{
+    // check channel activity before transmit, retry after random backoff up to backoff millisecond, 0 attempts disable
+    _lbtAttempts = attempts;
+    _lbtBackoff = backoff ? backoff : 1;
+}
+
+void SX126x::setDutyCycle(LoRaDutyCycle* dutyCycle)
+{
+    // track airtime of every transmit and refuse transmit when sub-band limit reached
+    _dutyCycle = dutyCycle;
+}
+
+bool SX126x::queuePacket(uint8_t* data, uint8_t length)
+{
+    // packet written to free space of radio buffer behind previously queued packets, also while transmitting
+    if (_txQueueCount >= SX126X_TX_QUEUE_SIZE || _txQueueBytes + length > 256) return false;
+    uint8_t offset = _txQueueWrite;
+    // defer DIO interrupt handler so it not use SPI in the middle of buffer write, interrupts stay enabled
+    _irqDefer = true;
+    sx126x_writeBuffer(offset, data, length, &_ctx);
+    _txQueueWrite += length;
+
+    // add packet to queue
+    uint8_t head = (_txQueueTail + _txQueueCount) % SX126X_TX_QUEUE_SIZE;
+    _txQueueOffset[head] = offset;
+    _txQueueLength[head] = length;
+    _txQueueBytes += length;
+    _txQueueCount++;
+    _irqDefer = false;
+
+    // run interrupt handler deferred during buffer write then start transmit when no queued packet transmitting
+    if (!_eventMode) process();
+    if (!_txQueueActive) _txQueueStart();
+    return true;
+}
+
+uint8_t SX126x::txQueued()
+{
+    // number of queued packets including packet being transmitted
+    return _txQueueCount;
+}
+
+uint16_t SX126x::txDropped()
+{
+    // number of queued packets dropped because transmit refused by duty cycle limit or busy channel
+    return _txDropped;
+}
+
 void SX126x::write(uint8_t data)
 {
     // write single byte of package to be transmitted
-    sx126x_writeBuffer(_bufferIndex, &data, 1);
+    if (_stageWrite(&data, 1)) return;
+    sx126x_writeBuffer(_bufferIndex, &data, 1, &_ctx);
     _bufferIndex++;
     _payloadTxRx++;
 }
 
 void SX126x::write(uint8_t* data, uint8_t length)
 {
-    // write multiple bytes of package to be transmitted
-    sx126x_writeBuffer(_bufferIndex, data, length);
+    // write multiple bytes of package to be transmitted, data can be reused when return
+    if (_stageWrite(data, length)) return;
+    sx126x_writeBuffer(_bufferIndex, data, length, &_ctx);
+    _bufferIndex += length;
+    _payloadTxRx += length;
+}
+
+void SX126x::writeAsync(uint8_t* data, uint8_t length, void(*callback)())
+{
+    // write multiple bytes of package with asynchronous transfer routine and return before transfer done
+    // data must stay valid and unchanged until callback called, callback called immediately when data copied to staging buffer
+    if (_stageWrite(data, length)) {
+        if (callback) callback();
+        return;
+    }
+    sx126x_writeBufferAsync(_bufferIndex, data, length, callback, &_ctx);
     _bufferIndex += length;
     _payloadTxRx += length;
 }
@@ -472,21 +630,49 @@ void SX126x::write(char* data, uint8_t length)
 {
     // write multiple bytes of package to be transmitted for char type
     uint8_t* data_ = (uint8_t*) data;
-    sx126x_writeBuffer(_bufferIndex, data_, length);
+    write(data_, length);
+}
+
+void SX126x::writev(const LoRaSegment* segments, uint8_t count)
+{
+    // write header and payload from separate buffers in single transfer without copying, copied when staging buffer used
+    if (_stage) {
+        for (uint8_t i=0; i<count; i++) {
+            // segment larger than staging buffer written directly
+            if (_stageWrite(segments[i].data, segments[i].length)) continue;
+            sx126x_writeBufferv(_bufferIndex, &segments[i], 1, &_ctx);
+            _bufferIndex += segments[i].length;
+            _payloadTxRx += segments[i].length;
+        }
+        return;
+    }
+    uint8_t length = 0;
+    for (uint8_t i=0; i<count; i++) length += segments[i].length;
+    sx126x_writeBufferv(_bufferIndex, segments, count, &_ctx);
     _bufferIndex += length;
     _payloadTxRx += length;
 }
 
+void SX126x::setPacketBuffer(uint8_t* buffer, uint8_t size)
+{
+    // stage written packet in RAM and send to radio in single transfer, received packet read at once to this buffer
+    _stage = size ? buffer : NULL;
+    _stageSize = size;
+    _stageLen = 0;
+    _stagePos = 0;
+}
+
 bool SX126x::request(uint32_t timeout)
 {
     // skip to enter RX mode when previous RX operation incomplete
-    if (getMode() == SX126X_STATUS_MODE_RX) return false;
+    if (_getMode() == SX126X_STATUS_MODE_RX) return false;
 
     // clear previous interrupt and set RX done, RX timeout, header error, and CRC error as interrupt source
     _irqSetup(SX126X_IRQ_RX_DONE | SX126X_IRQ_TIMEOUT | SX126X_IRQ_HEADER_ERR | SX126X_IRQ_CRC_ERR);
 
     // set status to RX wait or RX continuous wait
     _statusWait = SX126X_STATUS_RX_WAIT;
+    _waitExpected = 0;
     _statusIrq = 0x0000;
     // calculate RX timeout config
     uint32_t rxTimeout = timeout << 6;
@@ -495,6 +681,8 @@ bool SX126x::request(uint32_t timeout)
         rxTimeout = SX126X_RX_CONTINUOUS;
         _statusWait = SX126X_STATUS_RX_CONTINUOUS;
     }
+    // RX timeout workaround only needed after RX operation with timeout
+    _fixRxTimeout = rxTimeout != SX126X_RX_SINGLE && rxTimeout != SX126X_RX_CONTINUOUS;
 
     // set txen pin to low and rxen pin to high
     if ((_rxen != -1) && (_txen != -1)) {
@@ -504,15 +692,12 @@ bool SX126x::request(uint32_t timeout)
     }
 
     // set device to receive mode with configured timeout, single, or continuous operation
-    sx126x_setRx(rxTimeout);
+    sx126x_setRx(rxTimeout, &_ctx);
+    _mode = SX126X_STATUS_MODE_RX;
 
     // set operation status to wait and attach RX interrupt handler
-    if (_irq != -1) {
-        if (timeout == SX126X_RX_CONTINUOUS) {
-            attachInterrupt(_irqStatic, SX126x::_interruptRxContinuous, RISING);
-        } else {
-            attachInterrupt(_irqStatic, SX126x::_interruptRx, RISING);
-        }
+    if (_irq != -1 && !_eventMode) {
+        attachInterrupt(_irqNum, _interrupts[_slot], RISING);
     }
     return true;
 }
@@ -520,13 +705,14 @@ bool SX126x::request(uint32_t timeout)
 bool SX126x::listen(uint32_t rxPeriod, uint32_t sleepPeriod)
 {
     // skip to enter RX mode when previous RX operation incomplete
-    if (getMode() == SX126X_STATUS_MODE_RX) return false;
+    if (_getMode() == SX126X_STATUS_MODE_RX) return false;
 
     // clear previous interrupt and set RX done, RX timeout, header error, and CRC error as interrupt source
     _irqSetup(SX126X_IRQ_RX_DONE | SX126X_IRQ_TIMEOUT | SX126X_IRQ_HEADER_ERR | SX126X_IRQ_CRC_ERR);
 
     // set status to RX wait
     _statusWait = SX126X_STATUS_RX_WAIT;
+    _waitExpected = 0;
     _statusIrq = 0x0000;
     // calculate RX period and sleep period config
     rxPeriod = rxPeriod << 6;
@@ -542,11 +728,63 @@ bool SX126x::listen(uint32_t rxPeriod, uint32_t sleepPeriod)
     }
 
     // set device to receive mode with configured receive and sleep period
-    sx126x_setRxDutyCycle(rxPeriod, sleepPeriod);
+    sx126x_setRxDutyCycle(rxPeriod, sleepPeriod, &_ctx);
+    _mode = 0;
+    _fixRxTimeout = true;
 
     // set operation status to wait and attach RX interrupt handler
-    if (_irq != -1) {
-        attachInterrupt(_irqStatic, SX126x::_interruptRx, RISING);
+    if (_irq != -1 && !_eventMode) {
+        attachInterrupt(_irqNum, _interrupts[_slot], RISING);
+    }
+    return true;
+}
+
+bool SX126x::cad()
+{
+    // skip to start CAD when previous TX or RX operation incomplete
+    uint8_t mode = _getMode();
+    if (mode == SX126X_STATUS_MODE_TX || mode == SX126X_STATUS_MODE_RX) return false;
+
+    // clear previous interrupt and set CAD done and CAD detected as interrupt source
+    _irqSetup(SX126X_IRQ_CAD_DONE | SX126X_IRQ_CAD_DETECTED);
+
+    // set status to CAD wait and start channel activity detection
+    _statusWait = SX126X_STATUS_CAD_WAIT;
+    _statusIrq = 0x0000;
+    _cadStart();
+
+    // attach CAD interrupt handler
+    if (_irq != -1 && !_eventMode) {
+        attachInterrupt(_irqNum, _interrupts[_slot], RISING);
+    }
+    return true;
+}
+
+bool SX126x::listenCad(uint32_t sleepPeriod, uint32_t rxTimeout)
+{
+    // skip to enter RX mode when previous RX operation incomplete
+    if (_getMode() == SX126X_STATUS_MODE_RX) return false;
+
+    // clear previous interrupt and set CAD done, RX done, RX timeout, header error, and CRC error as interrupt source
+    _irqSetup(SX126X_IRQ_CAD_DONE | SX126X_IRQ_RX_DONE | SX126X_IRQ_TIMEOUT | SX126X_IRQ_HEADER_ERR | SX126X_IRQ_CRC_ERR);
+
+    // set status to RX wait
+    _statusWait = SX126X_STATUS_RX_WAIT;
+    _statusIrq = 0x0000;
+    // RX timeout after activity detected default to preamble time so false detection end soon
+    if (rxTimeout == 0) rxTimeout = lora_preambleTime(_sf, _bw, _preambleLength) / 1000 + 1;
+    _cadTimeout = rxTimeout << 6;
+    if (_cadTimeout > 0x00FFFFFF) _cadTimeout = 0x00FFFFFF;
+    _cadPeriod = sleepPeriod;
+    _cadListen = true;
+    _fixRxTimeout = true;
+
+    // start CAD, device enter RX mode directly when activity detected
+    _cadListenStart();
+
+    // set operation status to wait and attach RX interrupt handler
+    if (_irq != -1 && !_eventMode) {
+        attachInterrupt(_irqNum, _interrupts[_slot], RISING);
     }
     return true;
 }
@@ -561,7 +799,11 @@ uint8_t SX126x::read()
 {
     // read single byte of received package
     uint8_t buf;
-    sx126x_readBuffer(_bufferIndex, &buf, 1);
+    if (_stage) {
+        read(&buf, 1);
+        return buf;
+    }
+    sx126x_readBuffer(_bufferIndex, &buf, 1, &_ctx);
     _bufferIndex++;
     if (_payloadTxRx > 0) _payloadTxRx--;
     return buf;
@@ -569,8 +811,18 @@ uint8_t SX126x::read()
 
 uint8_t SX126x::read(uint8_t* data, uint8_t length)
 {
+    // copy from staging buffer, remaining payload loaded in single transfer when staging buffer empty
+    if (_stage) {
+        uint8_t n = 0;
+        while (n < length && _payloadTxRx) {
+            if (_stagePos >= _stageLen) _stageLoad();
+            data[n++] = _stage[_stagePos++];
+            _payloadTxRx--;
+        }
+        return n;
+    }
     // read multiple bytes of received package
-    sx126x_readBuffer(_bufferIndex, data, length);
+    sx126x_readBuffer(_bufferIndex, data, length, &_ctx);
     // return smallest between read length and size of package available
     _bufferIndex += length;
     _payloadTxRx = _payloadTxRx > length ? _payloadTxRx - length : 0;
@@ -581,14 +833,24 @@ uint8_t SX126x::read(char* data, uint8_t length)
 {
     // read multiple bytes of received package for char type
     uint8_t* data_ = (uint8_t*) data;
-    sx126x_readBuffer(_bufferIndex, data_, length);
-    _bufferIndex += length;
-    _payloadTxRx = _payloadTxRx > length ? _payloadTxRx - length : 0;
-    return _payloadTxRx > length ? length : _payloadTxRx;
+    return read(data_, length);
 }
 
 void SX126x::purge(uint8_t length)
 {
+    // drop bytes in staging buffer first
+    if (_stage && _stagePos < _stageLen) {
+        uint8_t staged = _stageLen - _stagePos;
+        if (length && length < staged) {
+            _stagePos += length;
+            _payloadTxRx -= length;
+            return;
+        }
+        _stageLen = 0;
+        _payloadTxRx -= staged;
+        if (length == staged) return;
+        if (length) length -= staged;
+    }
     // subtract or reset received payload length
     _payloadTxRx = (_payloadTxRx > length) && length ? _payloadTxRx - length : 0;
     _bufferIndex += length;
@@ -602,9 +864,39 @@ bool SX126x::wait(uint32_t timeout)
     // wait transmit or receive process finish by checking interrupt status or IRQ status
     uint16_t irqStat = 0x0000;
     uint32_t t = millis();
+    // first poll after expected transmit time then poll with increasing interval
+    uint32_t elapsed = micros() - _waitStart;
+    uint32_t interval = elapsed < _waitExpected ? _waitExpected - elapsed : 0;
+    uint32_t backoff = SX126X_POLL_INTERVAL_MIN;
+    uint32_t tPoll = micros();
+    _pollCount = 0;
     while (irqStat == 0x0000 && _statusIrq == 0x0000) {
-        // only check IRQ status register for non interrupt operation
-        if (_irq == -1) sx126x_getIrqStatus(&irqStat);
+        // start next CAD of CAD listen operation after sleep period
+        if (_cadIdle && millis() - _cadIdleTime >= _cadPeriod) {
+            _cadListenStart();
+            tPoll = micros();
+            interval = _waitExpected;
+            backoff = SX126X_POLL_INTERVAL_MIN;
+        }
+        // only check IRQ status register for non interrupt operation, handle pending interrupt in event mode
+        if (_irq == -1) {
+            uint32_t tNow = micros();
+            if (_cadIdle) {
+                // device sleeping between CAD so IRQ status not checked
+                delay(1);
+            } else if (tNow - tPoll >= interval) {
+                sx126x_getIrqStatus(&irqStat, &_ctx);
+                if (_cadListen && irqStat && _cadListenNext(irqStat)) irqStat = 0x0000;
+                _pollCount++;
+                tPoll = tNow;
+                interval = backoff;
+                if (backoff < SX126X_POLL_INTERVAL_MAX) backoff <<= 1;
+            } else if (interval - (tNow - tPoll) > 1000) {
+                // sleep instead of spinning when next poll more than 1 ms away
+                delay(1);
+            }
+        }
+        else if (_eventMode) process();
         // return when timeout reached
         if (millis() - t > timeout && timeout != 0) return false;
         yield();
@@ -619,22 +911,67 @@ bool SX126x::wait(uint32_t timeout)
         if (_txen != -1) digitalWrite(_txen, LOW);
     } else if (_statusWait == SX126X_STATUS_RX_WAIT) {
         // for receive, get received payload length and buffer index and set back rxen pin to low
-        sx126x_getRxBufferStatus(&_payloadTxRx, &_bufferIndex);
+        sx126x_getRxBufferStatus(&_payloadTxRx, &_bufferIndex, &_ctx);
+        _rxLength = _payloadTxRx;
+        _rxTime = micros();
+        _stageLen = 0;
         if (_rxen != -1) digitalWrite(_rxen, LOW);
-        sx126x_fixRxTimeout();
+        if (_fixRxTimeout) sx126x_fixRxTimeout(&_ctx);
+        if (_packetHandler && (irqStat & SX126X_IRQ_RX_DONE)) _handlePacket(irqStat);
     } else if (_statusWait == SX126X_STATUS_RX_CONTINUOUS) {
         // for receive continuous, get received payload length and buffer index and clear IRQ status
-        sx126x_getRxBufferStatus(&_payloadTxRx, &_bufferIndex);
-        sx126x_clearIrqStatus(0x03FF);
+        sx126x_getRxBufferStatus(&_payloadTxRx, &_bufferIndex, &_ctx);
+        _rxLength = _payloadTxRx;
+        _rxTime = micros();
+        _stageLen = 0;
+        sx126x_clearIrqStatus(0x03FF, &_ctx);
+        if (_pool && (irqStat & SX126X_IRQ_RX_DONE)) _storePacket(irqStat);
+        if (_packetHandler && (irqStat & SX126X_IRQ_RX_DONE)) _handlePacket(irqStat);
+    } else if (_statusWait == SX126X_STATUS_CAD_WAIT) {
+        // for CAD, set back rxen pin to low
+        if (_rxen != -1) digitalWrite(_rxen, LOW);
     }
 
-    // store IRQ status
+    // store IRQ status and start next queued packet after transmit done
     _statusIrq = irqStat;
+    if (_statusWait == SX126X_STATUS_TX_WAIT && _txQueueActive) _txQueueDone();
     return true;
 }
 
+void SX126x::setEventMode(bool enable)
+{
+    // keep interrupt attached and defer SPI transfer and callback of interrupt handler to process()
+    if (_irq != -1) {
+        if (enable && !_eventMode) attachInterrupt(_irqNum, _interrupts[_slot], RISING);
+        else if (!enable && _eventMode) detachInterrupt(_irqNum);
+    }
+    _eventMode = enable;
+    _eventPending = false;
+}
+
+bool SX126x::process()
+{
+    // run interrupt handler of pending event outside interrupt context
+    if (!_eventPending) return false;
+    _eventPending = false;
+    if (_statusWait == SX126X_STATUS_TX_WAIT) _interruptTx();
+    else if (_statusWait == SX126X_STATUS_CAD_WAIT) _interruptCad();
+    else if (_statusWait == SX126X_STATUS_RX_CONTINUOUS) _interruptRxContinuous();
+    else _interruptRx();
+    return true;
+}
+
+uint32_t SX126x::pollCount()
+{
+    // number of IRQ status reads of last wait in polling operation
+    return _pollCount;
+}
+
 uint8_t SX126x::status()
 {
+    // start next CAD of CAD listen operation after sleep period
+    if (_cadIdle && millis() - _cadIdleTime >= _cadPeriod) _cadListenStart();
+
     // set back status IRQ for RX continuous operation
     uint16_t statusIrq = _statusIrq;
     if (_statusWait == SX126X_STATUS_RX_CONTINUOUS) {
@@ -648,6 +985,8 @@ uint8_t SX126x::status()
     }
     else if (statusIrq & SX126X_IRQ_HEADER_ERR) return SX126X_STATUS_HEADER_ERR;
     else if (statusIrq & SX126X_IRQ_CRC_ERR) return SX126X_STATUS_CRC_ERR;
+    else if (statusIrq & SX126X_IRQ_CAD_DETECTED) return SX126X_STATUS_CAD_DETECTED;
+    else if (statusIrq & SX126X_IRQ_CAD_DONE) return SX126X_STATUS_CAD_DONE;
     else if (statusIrq & SX126X_IRQ_TX_DONE) return SX126X_STATUS_TX_DONE;
     else if (statusIrq & SX126X_IRQ_RX_DONE) return SX126X_STATUS_RX_DONE;
 
@@ -661,6 +1000,14 @@ uint32_t SX126x::transmitTime()
     return _transmitTime;
 }
 
+uint32_t SX126x::timeOnAir(uint8_t length)
+{
+    // calculate time on air in microsecond of packet with current modulation and packet parameters
+    uint8_t sf = _sf < 5 ? 5 : (_sf > 12 ? 12 : _sf);
+    uint8_t cr = _cr < 5 || _cr > 8 ? 5 : _cr;
+    return lora_timeOnAir(sf, _bw, cr, _ldro, _headerType == SX126X_HEADER_IMPLICIT, _preambleLength, _crcType, length, true);
+}
+
 float SX126x::dataRate()
 {
     // get data rate last transmitted package in kbps
@@ -671,7 +1018,7 @@ int16_t SX126x::packetRssi()
 {
     // get relative signal strength index (RSSI) of last incoming package
     uint8_t rssiPkt, snrPkt, signalRssiPkt;
-    sx126x_getPacketStatus(&rssiPkt, &snrPkt, &signalRssiPkt);
+    sx126x_getPacketStatus(&rssiPkt, &snrPkt, &signalRssiPkt, &_ctx);
     return (rssiPkt / -2);
 }
 
@@ -679,29 +1026,43 @@ float SX126x::snr()
 {
     // get signal to noise ratio (SNR) of last incoming package
     uint8_t rssiPkt, snrPkt, signalRssiPkt;
-    sx126x_getPacketStatus(&rssiPkt, &snrPkt, &signalRssiPkt);
+    sx126x_getPacketStatus(&rssiPkt, &snrPkt, &signalRssiPkt, &_ctx);
     return ((int8_t) snrPkt / 4.0);
 }
 
 int16_t SX126x::signalRssi()
 {
     uint8_t rssiPkt, snrPkt, signalRssiPkt;
-    sx126x_getPacketStatus(&rssiPkt, &snrPkt, &signalRssiPkt);
+    sx126x_getPacketStatus(&rssiPkt, &snrPkt, &signalRssiPkt, &_ctx);
     return (signalRssiPkt / -2);
 }
 
+void SX126x::packetInfo(LoRaPacketInfo* info)
+{
+    // get all status of last incoming package with single get packet status command
+    uint8_t rssiPkt, snrPkt, signalRssiPkt;
+    sx126x_getPacketStatus(&rssiPkt, &snrPkt, &signalRssiPkt, &_ctx);
+    info->length = _rxLength;
+    info->rssi = rssiPkt / -2;
+    info->snr = (int8_t) snrPkt / 4.0;
+    info->signalRssi = signalRssiPkt / -2;
+    info->freqError = 0;
+    info->irqStatus = _statusIrq;
+    info->timestamp = _rxTime;
+}
+
 int16_t SX126x::rssiInst()
 {
     uint8_t rssiInst;
-    sx126x_getRssiInst(&rssiInst);
+    sx126x_getRssiInst(&rssiInst, &_ctx);
     return (rssiInst / -2);
 }
 
 uint16_t SX126x::getError()
 {
     uint16_t error;
-    sx126x_getDeviceErrors(&error);
-    sx126x_clearDeviceErrors();
+    sx126x_getDeviceErrors(&error, &_ctx);
+    sx126x_clearDeviceErrors(&_ctx);
     return error;
 }
 
@@ -709,7 +1070,7 @@ uint32_t SX126x::random()
 {
     // generate random number from register and previous random number
     uint8_t buf[4];
-    sx126x_readRegister(SX126X_REG_RANDOM_NUMBER_GEN, buf, 4);
+    sx126x_readRegister(SX126X_REG_RANDOM_NUMBER_GEN, buf, 4, &_ctx);
     uint32_t number = ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) | ((uint32_t) buf[2] << 8) | ((uint32_t) buf[0]);
     uint32_t n = _random;
     number = number ^ ((~n << 16) | n);
@@ -720,10 +1081,221 @@ uint32_t SX126x::random()
     return number;
 }
 
+uint8_t SX126x::_getMode()
+{
+    // TX and RX single operation end in fallback mode when IRQ status already shows operation finished
+    if (_mode == SX126X_STATUS_MODE_TX && (_statusIrq & (SX126X_IRQ_TX_DONE | SX126X_IRQ_TIMEOUT))) {
+        _mode = _fallbackMode;
+    } else if (_mode == SX126X_STATUS_MODE_RX && _statusWait == SX126X_STATUS_RX_WAIT && (_statusIrq & (SX126X_IRQ_RX_DONE | SX126X_IRQ_TIMEOUT))) {
+        _mode = _fallbackMode;
+    }
+    // only ask device when current mode can change without command or unknown
+    if (_mode == SX126X_STATUS_MODE_TX || _mode == SX126X_STATUS_MODE_RX || _mode == 0) {
+        _mode = getMode();
+    }
+    return _mode;
+}
+
+void SX126x::_cacheRegisters()
+{
+    // read registers used by workaround once then keep them in software until reset or sleep
+    if (_regCached) return;
+    sx126x_readRegister(SX126X_REG_TX_MODULATION, &_txModulation, 1, &_ctx);
+    sx126x_readRegister(SX126X_REG_IQ_POLARITY_SETUP, &_iqPolarity, 1, &_ctx);
+    _regCached = true;
+}
+
+void SX126x::_fixLoRaBw500()
+{
+    // only write TX modulation register when workaround bit change
+    _cacheRegisters();
+    uint8_t value = _txModulation;
+    if ((_modem == SX126X_LORA_MODEM) && (_bw == 500000)) value &= 0xFB;
+    else value |= 0x04;
+    if (value == _txModulation) return;
+    sx126x_writeRegister(SX126X_REG_TX_MODULATION, &value, 1, &_ctx);
+    _txModulation = value;
+}
+
+void SX126x::_fixInvertedIq()
+{
+    // only write IQ polarity register when invert IQ setting change
+    _cacheRegisters();
+    uint8_t value = _iqPolarity;
+    if (_invertIq) value |= 0x04;
+    else value &= 0xFB;
+    if (value == _iqPolarity) return;
+    sx126x_writeRegister(SX126X_REG_IQ_POLARITY_SETUP, &value, 1, &_ctx);
+    _iqPolarity = value;
+}
+
+bool SX126x::_stageWrite(const uint8_t* data, uint8_t length)
+{
+    // copy to staging buffer, flush staged bytes first when buffer full and write directly when data larger than buffer
+    if (_stage == NULL) return false;
+    if (_stageLen + length > _stageSize) {
+        _stageFlush();
+        if (length > _stageSize) return false;
+    }
+    memcpy(_stage + _stageLen, data, length);
+    _stageLen += length;
+    _payloadTxRx += length;
+    return true;
+}
+
+void SX126x::_stageFlush()
+{
+    sx126x_writeBuffer(_bufferIndex, _stage, _stageLen, &_ctx);
+    _bufferIndex += _stageLen;
+    _stageLen = 0;
+}
+
+void SX126x::_stageLoad()
+{
+    // read remaining received payload or as much as staging buffer size
+    uint8_t length = _payloadTxRx < _stageSize ? _payloadTxRx : _stageSize;
+    sx126x_readBuffer(_bufferIndex, _stage, length, &_ctx);
+    _bufferIndex += length;
+    _stageLen = length;
+    _stagePos = 0;
+}
+
+void SX126x::_txQueueStart()
+{
+    // transmit packet at queue tail which already written in buffer, drop packet when transmit refused and try next one
+    while (_txQueueCount) {
+        _bufferIndex = _txQueueOffset[_txQueueTail];
+        beginPacket();
+        _payloadTxRx = _txQueueLength[_txQueueTail];
+        _txQueueActive = endPacket(SX126X_TX_SINGLE);
+        if (_txQueueActive) return;
+        _txDropped++;
+        _txQueueRemove();
+    }
+}
+
+void SX126x::_txQueueDone()
+{
+    // free buffer space of transmitted packet then start next queued packet
+    _txQueueActive = false;
+    _txQueueRemove();
+    if (_txQueueCount) _txQueueStart();
+}
+
+void SX126x::_txQueueRemove()
+{
+    _txQueueBytes -= _txQueueLength[_txQueueTail];
+    _txQueueTail = (_txQueueTail + 1) % SX126X_TX_QUEUE_SIZE;
+    _txQueueCount--;
+}
+
+void SX126x::_cadStart()
+{
+    // CAD parameters from SF as recommended by Semtech, 2 symbols for SF below 9 and 4 symbols otherwise
+    uint8_t symbolNum = _sf < 9 ? SX126X_CAD_ON_2_SYMB : SX126X_CAD_ON_4_SYMB;
+    sx126x_setCadParams(symbolNum, _sf + 13, 10, SX126X_CAD_EXIT_STDBY, 0, &_ctx);
+
+    // set txen pin to low and rxen pin to high
+    if ((_rxen != -1) && (_txen != -1)) {
+        digitalWrite(_rxen, HIGH);
+        digitalWrite(_txen, LOW);
+        _pinToLow = _rxen;
+    }
+
+    // device go back to standby after CAD done
+    sx126x_setCad(&_ctx);
+    _mode = 0;
+    _waitStart = micros();
+    _waitExpected = lora_symbolTime(_sf, _bw) << symbolNum;
+}
+
+bool SX126x::_channelClear()
+{
+    // CAD with IRQ status polling and no DIO interrupt so interrupt handler not called
+    bool clear = false;
+    for (uint8_t i=0; i<_lbtAttempts; i++) {
+        // back off random time before next attempt while channel busy
+        if (i) delay(random() % _lbtBackoff);
+        sx126x_clearIrqStatus(0x03FF, &_ctx);
+        sx126x_setDioIrqParams(SX126X_IRQ_CAD_DONE | SX126X_IRQ_CAD_DETECTED, 0x0000, 0x0000, 0x0000, &_ctx);
+        _cadStart();
+        // give up as busy when CAD not done within twice expected CAD time
+        uint32_t t = millis();
+        uint32_t timeout = _waitExpected / 500 + 10;
+        uint16_t irqStat = 0x0000;
+        while (!(irqStat & SX126X_IRQ_CAD_DONE)) {
+            if (millis() - t > timeout) break;
+            sx126x_getIrqStatus(&irqStat, &_ctx);
+        }
+        if (!(irqStat & SX126X_IRQ_CAD_DONE)) {
+            standby();
+            break;
+        }
+        if (!(irqStat & SX126X_IRQ_CAD_DETECTED)) {
+            clear = true;
+            break;
+        }
+    }
+
+    // set back txen pin to high and rxen pin to low for following transmit
+    if ((_rxen != -1) && (_txen != -1)) {
+        digitalWrite(_rxen, LOW);
+        digitalWrite(_txen, HIGH);
+        _pinToLow = _txen;
+    }
+    return clear;
+}
+
+void SX126x::_cadListenStart()
+{
+    // wake device from sleep by set nss to low then start CAD with RX exit mode
+    if (_cadIdle) digitalWrite(_ctx.nss, LOW);
+    _cadIdle = false;
+    uint8_t symbolNum = _sf < 9 ? SX126X_CAD_ON_2_SYMB : SX126X_CAD_ON_4_SYMB;
+    sx126x_setCadParams(symbolNum, _sf + 13, 10, SX126X_CAD_EXIT_RX, _cadTimeout, &_ctx);
+
+    // set txen pin to low and rxen pin to high
+    if ((_rxen != -1) && (_txen != -1)) {
+        digitalWrite(_rxen, HIGH);
+        digitalWrite(_txen, LOW);
+        _pinToLow = _rxen;
+    }
+
+    sx126x_setCad(&_ctx);
+    _mode = 0;
+    _waitStart = micros();
+    _waitExpected = lora_symbolTime(_sf, _bw) << symbolNum;
+}
+
+bool SX126x::_cadListenNext(uint16_t irqStat)
+{
+    // packet received or error end CAD listen operation, return false so caller finish receive
+    if (irqStat & (SX126X_IRQ_RX_DONE | SX126X_IRQ_HEADER_ERR | SX126X_IRQ_CRC_ERR)) {
+        _cadListen = false;
+        return false;
+    }
+    sx126x_clearIrqStatus(0x03FF, &_ctx);
+    // activity detected and device already in RX mode, keep waiting RX done
+    if ((irqStat & SX126X_IRQ_CAD_DETECTED) && !(irqStat & SX126X_IRQ_TIMEOUT)) return true;
+
+    // no activity or RX timeout after false detection, put device to sleep until next CAD
+    if (_pinToLow != -1) digitalWrite(_pinToLow, LOW);
+    sx126x_setSleep(SX126X_SLEEP_WARM_START, &_ctx);
+    _mode = 0;
+    _regCached = false;
+    _cadIdleTime = millis();
+    _cadIdle = true;
+    return true;
+}
+
 void SX126x::_irqSetup(uint16_t irqMask)
 {
+    // new operation end previous CAD listen operation
+    _cadListen = false;
+    _cadIdle = false;
+
     // clear IRQ status of previous transmit or receive operation
-    sx126x_clearIrqStatus(0x03FF);
+    sx126x_clearIrqStatus(0x03FF, &_ctx);
 
     // set selected interrupt source
     uint16_t dio1Mask = 0x0000;
@@ -732,7 +1304,54 @@ void SX126x::_irqSetup(uint16_t irqMask)
     if (_dio == 2) dio2Mask = irqMask;
     else if (_dio == 3) dio3Mask = irqMask;
     else dio1Mask = irqMask;
-    sx126x_setDioIrqParams(irqMask, dio1Mask, dio2Mask, dio3Mask);
+    sx126x_setDioIrqParams(irqMask, dio1Mask, dio2Mask, dio3Mask, &_ctx);
+}
+
+void SX126x::_interrupt0()
+{
+    _instances[0]->_interrupt();
+}
+
+void SX126x::_interrupt1()
+{
+    _instances[1]->_interrupt();
+}
+
+void SX126x::_interrupt2()
+{
+    _instances[2]->_interrupt();
+}
+
+void SX126x::_interrupt3()
+{
+    _instances[3]->_interrupt();
+}
+
+void SX126x::_interrupt()
+{
+    // in event mode, while interrupt deferred, or while asynchronous transfer use SPI bus only flag interrupt,
+    // handler called later by process() or by _asyncIdle() when transfer done
+    _irqTime = micros();
+    _eventPending = true;
+    if (_eventMode || _irqDefer || sx126x_asyncBusy()) return;
+    _dispatch();
+}
+
+void SX126x::_dispatch()
+{
+    // run handler of flagged interrupt in interrupt context
+    _inInterrupt = true;
+    process();
+    _inInterrupt = false;
+}
+
+void SX126x::_asyncIdle()
+{
+    // run interrupt handler deferred while asynchronous transfer used SPI bus
+    for (uint8_t i=0; i<SX126X_MAX_INSTANCES; i++) {
+        SX126x* radio = _instances[i];
+        if (radio && radio->_eventPending && !(radio->_eventMode || radio->_irqDefer)) radio->_dispatch();
+    }
 }
 
 void SX126x::_interruptTx()
@@ -742,29 +1361,43 @@ void SX126x::_interruptTx()
 
     // set back txen pin to low and detach interrupt
     if (_pinToLow != -1) digitalWrite(_pinToLow, LOW);
-    detachInterrupt(_irqStatic);
+    if (!_eventMode) detachInterrupt(_irqNum);
 
     // store IRQ status
-    sx126x_getIrqStatus(&_statusIrq);
+    sx126x_getIrqStatus(&_statusIrq, &_ctx);
 
     // call onTransmit function
     if (_onTransmit) {
         _onTransmit();
     }
+
+    // start next queued packet
+    if (_txQueueActive) _txQueueDone();
 }
 
 void SX126x::_interruptRx()
 {
+    // keep CAD listen operation running when no packet received yet
+    if (_cadListen) {
+        uint16_t irqStat;
+        sx126x_getIrqStatus(&irqStat, &_ctx);
+        if (_cadListenNext(irqStat)) return;
+    }
+
     // set back rxen pin to low and detach interrupt
     if (_pinToLow != -1) digitalWrite(_pinToLow, LOW);
-    detachInterrupt(_irqStatic);
-    sx126x_fixRxTimeout();
+    if (!_eventMode) detachInterrupt(_irqNum);
+    if (_fixRxTimeout) sx126x_fixRxTimeout(&_ctx);
 
     // store IRQ status
-    sx126x_getIrqStatus(&_statusIrq);
+    sx126x_getIrqStatus(&_statusIrq, &_ctx);
 
     // get received payload length and buffer index
-    sx126x_getRxBufferStatus(&_payloadTxRx, &_bufferIndex);
+    sx126x_getRxBufferStatus(&_payloadTxRx, &_bufferIndex, &_ctx);
+    _rxLength = _payloadTxRx;
+    _rxTime = _irqTime;
+    _stageLen = 0;
+    if (_packetHandler && (_statusIrq & SX126X_IRQ_RX_DONE)) _handlePacket(_statusIrq);
 
     // call onReceive function
     if (_onReceive) {
@@ -775,13 +1408,18 @@ void SX126x::_interruptRx()
 void SX126x::_interruptRxContinuous()
 {
     // store IRQ status
-    sx126x_getIrqStatus(&_statusIrq);
+    sx126x_getIrqStatus(&_statusIrq, &_ctx);
 
     // clear IRQ status
-    sx126x_clearIrqStatus(0x03FF);
+    sx126x_clearIrqStatus(0x03FF, &_ctx);
 
     // get received payload length and buffer index
-    sx126x_getRxBufferStatus(&_payloadTxRx, &_bufferIndex);
+    sx126x_getRxBufferStatus(&_payloadTxRx, &_bufferIndex, &_ctx);
+    _rxLength = _payloadTxRx;
+    _rxTime = _irqTime;
+    _stageLen = 0;
+    if (_pool && (_statusIrq & SX126X_IRQ_RX_DONE)) _storePacket(_statusIrq);
+    if (_packetHandler && (_statusIrq & SX126X_IRQ_RX_DONE)) _handlePacket(_statusIrq);
 
     // call onReceive function
     if (_onReceive) {
@@ -789,6 +1427,93 @@ void SX126x::_interruptRxContinuous()
     }
 }
 
+void SX126x::_interruptCad()
+{
+    // set back rxen pin to low and detach interrupt
+    if (_pinToLow != -1) digitalWrite(_pinToLow, LOW);
+    if (!_eventMode) detachInterrupt(_irqNum);
+
+    // store IRQ status
+    sx126x_getIrqStatus(&_statusIrq, &_ctx);
+}
+
+void SX126x::setPacketPool(LoRaPacket* pool, uint8_t size)
+{
+    // received packets in RX continuous operation copied to pool, one slot always kept empty
+    _pool = size > 1 ? pool : NULL;
+    _poolSize = _pool ? size : 0;
+    _poolHead = 0;
+    _poolTail = 0;
+    _poolDropped = 0;
+}
+
+uint8_t SX126x::packetsAvailable()
+{
+    if (_pool == NULL) return 0;
+    uint8_t head = _poolHead;
+    return (head + _poolSize - _poolTail) % _poolSize;
+}
+
+bool SX126x::readPacket(LoRaPacket* packet)
+{
+    // copy oldest packet from pool, only interrupt handler move head and only this method move tail
+    if (_pool == NULL || _poolTail == _poolHead) return false;
+    // slot must not be read before head checked
+    __asm__ volatile ("" ::: "memory");
+    *packet = _pool[_poolTail];
+    // slot copy must be complete before tail released to interrupt handler
+    __asm__ volatile ("" ::: "memory");
+    _poolTail = (_poolTail + 1) % _poolSize;
+    return true;
+}
+
+uint16_t SX126x::packetsDropped()
+{
+    return _poolDropped;
+}
+
+void SX126x::_storePacket(uint16_t irqStatus)
+{
+    // copy received packet and its status to pool slot at head, skip corrupted packet and drop packet when pool full
+    if (irqStatus & (SX126X_IRQ_CRC_ERR | SX126X_IRQ_HEADER_ERR)) return;
+    uint8_t next = (_poolHead + 1) % _poolSize;
+    if (next == _poolTail) {
+        _poolDropped++;
+        return;
+    }
+    LoRaPacket* packet = &_pool[_poolHead];
+    LoRaPacketInfo info;
+    packetInfo(&info);
+    packet->length = _payloadTxRx;
+    sx126x_readBuffer(_bufferIndex, packet->data, packet->length, &_ctx);
+    packet->rssi = info.rssi;
+    packet->snr = info.snr;
+    packet->irqStatus = irqStatus;
+    packet->timestamp = info.timestamp;
+    // slot contents must be written before head published to readPacket
+    __asm__ volatile ("" ::: "memory");
+    _poolHead = next;
+    // packet already read from buffer, keep payload length when packet handler also want it
+    if (_packetHandler == NULL) _payloadTxRx = 0;
+}
+
+void SX126x::_handlePacket(uint16_t irqStatus)
+{
+    // read whole payload in one burst to buffer from provider then pass it to handler with packet status
+    if (_payloadTxRx == 0 || (irqStatus & (SX126X_IRQ_CRC_ERR | SX126X_IRQ_HEADER_ERR))) return;
+    LoRaPacketInfo info;
+    packetInfo(&info);
+    info.length = _payloadTxRx;
+    info.irqStatus = irqStatus;
+    uint8_t* buffer = _bufferProvider(_handlerContext, info.length);
+    if (buffer) {
+        sx126x_readBuffer(_bufferIndex, buffer, info.length, &_ctx);
+        _packetHandler(_handlerContext, buffer, info.length, info);
+    }
+    // packet already consumed
+    _payloadTxRx = 0;
+}
+
 void SX126x::onTransmit(void(&callback)())
 {
     // register onTransmit function to call every transmit done
@@ -800,3 +1525,17 @@ void SX126x::onReceive(void(&callback)())
     // register onReceive function to call every receive done
     _onReceive = &callback;
 }
+
+void SX126x::onReceive(LoRaBufferProvider provider, LoRaPacketHandler handler, void* context)
+{
+    // register buffer provider and handler to receive every packet directly to caller buffer, set NULL to disable
+    _bufferProvider = provider;
+    _packetHandler = provider ? handler : NULL;
+    _handlerContext = context;
+}
+
+void SX126x::onBusy(void(&callback)(uint8_t opCode, uint32_t waitTime))
+{
+    // register onBusy function to measure busy wait time of each command
+    sx126x_onBusy(&callback, &_ctx);
+}
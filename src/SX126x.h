@@ -2,6 +2,7 @@
 #define _SX126X_H_
 
 #include <BaseLoRa.h>
+#include <LoRaDutyCycle.h>
 #include <SX126x_driver.h>
 
 // Status TX and RX operation
@@ -21,6 +22,10 @@
 
 // Default Hardware Configuration
 #define SX126X_PIN_RF_IRQ                             1
+#define SX126X_MAX_INSTANCES                          4     // maximum objects using interrupt handler
+#define SX126X_TX_QUEUE_SIZE                          4     // maximum packets in transmit queue
+#define SX126X_POLL_INTERVAL_MIN                    100     // first IRQ status poll interval after expected finish in microsecond
+#define SX126X_POLL_INTERVAL_MAX                  10000     // maximum IRQ status poll interval in microsecond
 
 #if defined(USE_LORA_SX126X) && defined(USE_LORA_SX127X)
 class SX126x : public BaseLoRa
@@ -32,6 +37,7 @@ class SX126x
     public:
 
         SX126x();
+        ~SX126x();
 
         // Common Operational methods
         bool begin();
@@ -45,6 +51,8 @@ class SX126x
         bool busyCheck(uint32_t timeout=SX126X_BUSY_TIMEOUT);
         void setFallbackMode(uint8_t fallbackMode);
         uint8_t getMode();
+        void beginBatch(uint8_t* buffer, uint16_t size);
+        uint32_t endBatch();
 
         // Hardware configuration methods
         void setSPI(SPIClass &SpiObject, uint32_t frequency=SX126X_SPI_FREQUENCY);
@@ -59,6 +67,14 @@ class SX126x
         // Modem, modulation parameter, and packet parameter setup methods
         void setModem(uint8_t modem=SX126X_LORA_MODEM);
         void setFrequency(uint32_t frequency);
+        void setChannel(uint32_t channel);
+        void setHopTable(const uint32_t* channels, uint8_t count);
+        uint8_t hop();
+        void hop(uint8_t index);
+        static constexpr uint32_t channelWord(uint32_t frequency)
+        {
+            return ((uint64_t) frequency << SX126X_RF_FREQUENCY_SHIFT) / SX126X_RF_FREQUENCY_XTAL;
+        }
         void setTxPower(uint8_t txPower, uint8_t version=SX126X_TX_POWER_SX1262);
         void setRxGain(uint8_t boost);
         void setLoRaModulation(uint8_t sf, uint32_t bw, uint8_t cr, bool ldro=false);
@@ -82,57 +98,69 @@ class SX126x
 
         // Transmit related methods
         void beginPacket();
+        void setDutyCycle(LoRaDutyCycle* dutyCycle);
         bool endPacket(uint32_t timeout=SX126X_TX_SINGLE);
+        bool queuePacket(uint8_t* data, uint8_t length);
+        void setListenBeforeTalk(uint8_t attempts=3, uint32_t backoff=100);
+        uint8_t txQueued();
+        uint16_t txDropped();
         void write(uint8_t data);
         void write(uint8_t* data, uint8_t length);
         void write(char* data, uint8_t length);
-        template <typename T> void put(T data)
+        void writev(const LoRaSegment* segments, uint8_t count);
+        void writeAsync(uint8_t* data, uint8_t length, void(*callback)()=NULL);
+        template <typename T> void put(T data, uint8_t endian=LORA_LITTLE_ENDIAN)
         {
-            const uint8_t length = sizeof(T);
-            union conv {
-                T Data;
-                uint8_t Binary[length];
-            };
-            union conv u;
-            u.Data = data;
-            sx126x_writeBuffer(_bufferIndex, u.Binary, length);
-            _bufferIndex += length;
-            _payloadTxRx += length;
+            uint8_t buf[sizeof(T)];
+            memcpy(buf, &data, sizeof(T));
+            lora_byteOrder(buf, sizeof(T), endian);
+            if (_stageWrite(buf, sizeof(T))) return;
+            sx126x_writeBuffer(_bufferIndex, buf, sizeof(T), &_ctx);
+            _bufferIndex += sizeof(T);
+            _payloadTxRx += sizeof(T);
         }
+        void setPacketBuffer(uint8_t* buffer, uint8_t size);
         void onTransmit(void(&callback)());
 
         // Receive related methods
         bool request(uint32_t timeout=SX126X_RX_SINGLE);
         bool listen(uint32_t rxPeriod, uint32_t sleepPeriod);
+        bool listenCad(uint32_t sleepPeriod, uint32_t rxTimeout=0);
+        bool cad();
         uint8_t available();
         uint8_t read();
         uint8_t read(uint8_t* data, uint8_t length);
         uint8_t read(char* data, uint8_t length);
         void purge(uint8_t length=0);
-        template <typename T> uint8_t get(T &data)
+        template <typename T> uint8_t get(T &data, uint8_t endian=LORA_LITTLE_ENDIAN)
         {
-            const uint8_t length = sizeof(T);
-            union conv {
-                T Data;
-                uint8_t Binary[length];
-            };
-            union conv u;
-            sx126x_readBuffer(_bufferIndex, u.Binary, length);
-            data = u.Data;
-            _bufferIndex += length;
-            _payloadTxRx = _payloadTxRx > length ? _payloadTxRx - length : 0;
-            return _payloadTxRx > length ? length : _payloadTxRx;
+            uint8_t buf[sizeof(T)];
+            uint8_t len = read(buf, sizeof(T));
+            lora_byteOrder(buf, sizeof(T), endian);
+            memcpy(&data, buf, sizeof(T));
+            return len;
         }
         void onReceive(void(&callback)());
+        void onReceive(LoRaBufferProvider provider, LoRaPacketHandler handler, void* context=NULL);
+        void setPacketPool(LoRaPacket* pool, uint8_t size);
+        uint8_t packetsAvailable();
+        bool readPacket(LoRaPacket* packet);
+        uint16_t packetsDropped();
+        void onBusy(void(&callback)(uint8_t opCode, uint32_t waitTime));
 
         // Wait, operation status, and packet status methods
         bool wait(uint32_t timeout=0);
+        void setEventMode(bool enable=true);
+        bool process();
+        uint32_t pollCount();
         uint8_t status();
         uint32_t transmitTime();
+        uint32_t timeOnAir(uint8_t length);
         float dataRate();
         int16_t packetRssi();
         float snr();
         int16_t signalRssi();
+        void packetInfo(LoRaPacketInfo* info);
         int16_t rssiInst();
         uint16_t getError();
         uint32_t random();
@@ -140,6 +168,7 @@ class SX126x
     protected:
 
         uint8_t _modem;
+        uint32_t _frequency = 0;
         uint8_t _sf = 7;
         uint32_t _bw = 125000;
         uint8_t _cr = 4;
@@ -149,33 +178,126 @@ class SX126x
         uint8_t _payloadLength;
         bool _crcType;
         bool _invertIq;
-        static void (*_onTransmit)();
-        static void (*_onReceive)();
+        void (*_onTransmit)() = NULL;
+        void (*_onReceive)() = NULL;
 
     private:
 
-        SPIClass* _spi;
-        int8_t _nss, _reset, _busy, _irq, _txen, _rxen;
+        sx126x_context _ctx;
+        int8_t _reset, _irq, _txen, _rxen;
         int8_t _dio;
         uint8_t _statusWait;
-        static uint16_t _statusIrq;
-        static uint32_t _transmitTime;
-        static uint8_t _bufferIndex;
-        static uint8_t _payloadTxRx;
-        static int8_t _irqStatic;
-        static int8_t _pinToLow;
+        uint16_t _statusIrq = 0xFFFF;
+        uint32_t _transmitTime = 0;
+        uint8_t _bufferIndex = 0;
+        uint8_t _payloadTxRx = 0;
+        int8_t _irqNum = -1;
+        int8_t _pinToLow = -1;
+        bool _fixRxTimeout = false;
+        uint8_t _slot;
         uint16_t _random;
+        uint8_t _mode = 0;
+        uint8_t _fallbackMode = SX126X_FALLBACK_STDBY_RC;
+        bool _regCached = false;
+        uint8_t _txModulation;
+        uint8_t _iqPolarity;
+        uint8_t _calFreq = 0;
+        const uint32_t* _hopTable = NULL;
+        uint8_t _hopCount = 0;
+        uint8_t _hopIndex = 0;
+        LoRaDutyCycle* _dutyCycle = NULL;
+        uint8_t _txQueueOffset[SX126X_TX_QUEUE_SIZE];
+        uint8_t _txQueueLength[SX126X_TX_QUEUE_SIZE];
+        volatile uint8_t _txQueueTail = 0;
+        volatile uint8_t _txQueueCount = 0;
+        volatile uint16_t _txQueueBytes = 0;
+        volatile bool _txQueueActive = false;
+        volatile uint16_t _txDropped = 0;
+        uint8_t _txQueueWrite = 0;
+        uint8_t _rxLength = 0;
+        uint32_t _rxTime = 0;
+        uint32_t _waitStart = 0;
+        uint32_t _waitExpected = 0;
+        uint32_t _pollCount = 0;
+        bool _cadListen = false;
+        volatile bool _cadIdle = false;
+        uint32_t _cadIdleTime = 0;
+        uint32_t _cadPeriod = 0;
+        uint32_t _cadTimeout = 0;
+        uint8_t _lbtAttempts = 0;
+        uint32_t _lbtBackoff = 1;
+        bool _inInterrupt = false;
+        bool _eventMode = false;
+        volatile bool _eventPending = false;
+        volatile bool _irqDefer = false;
+        volatile uint32_t _irqTime = 0;
+        uint8_t* _stage = NULL;
+        uint8_t _stageSize = 0;
+        uint8_t _stageLen = 0;
+        uint8_t _stagePos = 0;
+        LoRaBufferProvider _bufferProvider = NULL;
+        LoRaPacketHandler _packetHandler = NULL;
+        void* _handlerContext = NULL;
+        LoRaPacket* _pool = NULL;
+        uint8_t _poolSize = 0;
+        volatile uint8_t _poolHead = 0;
+        volatile uint8_t _poolTail = 0;
+        volatile uint16_t _poolDropped = 0;
+
+        // Cached state and workaround methods
+        uint8_t _getMode();
+        void _cacheRegisters();
+        void _fixLoRaBw500();
+        void _fixInvertedIq();
+
+        // Transmit queue methods
+        void _txQueueStart();
+        void _txQueueDone();
+        void _txQueueRemove();
+
+        // Channel activity detection methods
+        void _cadStart();
+        bool _channelClear();
+        void _cadListenStart();
+        bool _cadListenNext(uint16_t irqStat);
+
+        // Staging buffer methods
+        bool _stageWrite(const uint8_t* data, uint8_t length);
+        void _stageFlush();
+        void _stageLoad();
+
+        // Packet pool methods
+        void _storePacket(uint16_t irqStatus);
+        void _handlePacket(uint16_t irqStatus);
 
-        // Interrupt handler methods
+        // Interrupt handler methods, static handler for each instance slot forward interrupt to its object
+        static SX126x* _instances[SX126X_MAX_INSTANCES];
+        static void (*const _interrupts[SX126X_MAX_INSTANCES])();
         void _irqSetup(uint16_t irqMask);
 #ifdef ESP8266
-        static void ICACHE_RAM_ATTR _interruptTx();
-        static void ICACHE_RAM_ATTR _interruptRx();
-        static void ICACHE_RAM_ATTR _interruptRxContinuous();
+        static void ICACHE_RAM_ATTR _interrupt0();
+        static void ICACHE_RAM_ATTR _interrupt1();
+        static void ICACHE_RAM_ATTR _interrupt2();
+        static void ICACHE_RAM_ATTR _interrupt3();
+        void ICACHE_RAM_ATTR _interrupt();
+        void ICACHE_RAM_ATTR _dispatch();
+        static void ICACHE_RAM_ATTR _asyncIdle();
+        void ICACHE_RAM_ATTR _interruptTx();
+        void ICACHE_RAM_ATTR _interruptRx();
+        void ICACHE_RAM_ATTR _interruptRxContinuous();
+        void ICACHE_RAM_ATTR _interruptCad();
 #else
-        static void _interruptTx();
-        static void _interruptRx();
-        static void _interruptRxContinuous();
+        static void _interrupt0();
+        static void _interrupt1();
+        static void _interrupt2();
+        static void _interrupt3();
+        void _interrupt();
+        void _dispatch();
+        static void _asyncIdle();
+        void _interruptTx();
+        void _interruptRx();
+        void _interruptRxContinuous();
+        void _interruptCad();
 #endif
 
 };
@@ -1,20 +1,65 @@
 #include <SX126x_driver.h>
 
-SPIClass* sx126x_spi = &SX126X_SPI;
-uint32_t sx126x_spiFrequency = SX126X_SPI_FREQUENCY;
-int8_t sx126x_nss = SX126X_PIN_NSS;
-int8_t sx126x_busy = SX126X_PIN_BUSY;
+sx126x_context sx126x_defaultContext = {&SX126X_SPI, SX126X_SPI_FREQUENCY, SX126X_PIN_NSS, SX126X_PIN_BUSY, 0x00, NULL, NULL, 0, 0
+#ifdef __AVR__
+    , NULL, NULL, 0, 0
+#endif
+};
+sx126x_context* sx126x_activeContext = &sx126x_defaultContext;
+sx126x_context* sx126x_asyncContext = &sx126x_defaultContext;
+bool (*sx126x_asyncTransfer)(uint8_t* txBuf, uint8_t* rxBuf, uint16_t length) = NULL;
+void (*sx126x_asyncCallback)() = NULL;
+void (*sx126x_asyncIdle)() = NULL;
+volatile bool sx126x_asyncPending = false;
 
-void sx126x_setSPI(SPIClass &SpiObject, uint32_t frequency)
+static void sx126x_pinCache(sx126x_context* ctx)
 {
-    sx126x_spi = &SpiObject;
-    sx126x_spiFrequency = frequency ? frequency : sx126x_spiFrequency;
+#ifdef __AVR__
+    // cache port register and bit mask of pins so no pin table lookup on every transfer
+    ctx->nssPort = ctx->nss < 0 ? NULL : portOutputRegister(digitalPinToPort(ctx->nss));
+    ctx->nssMask = ctx->nss < 0 ? 0 : digitalPinToBitMask(ctx->nss);
+    ctx->busyPort = ctx->busy < 0 ? NULL : portInputRegister(digitalPinToPort(ctx->busy));
+    ctx->busyMask = ctx->busy < 0 ? 0 : digitalPinToBitMask(ctx->busy);
+#else
+    (void) ctx;
+#endif
 }
 
-void sx126x_setPins(int8_t nss, int8_t busy)
+static inline void sx126x_nssWrite(sx126x_context* ctx, uint8_t level)
 {
-    sx126x_nss = nss;
-    sx126x_busy = busy;
+#ifdef __AVR__
+    if (ctx->nssPort) {
+        // read modify write of port register must not be interrupted
+        uint8_t sreg = SREG;
+        cli();
+        if (level) *ctx->nssPort |= ctx->nssMask;
+        else *ctx->nssPort &= ~ctx->nssMask;
+        SREG = sreg;
+        return;
+    }
+#endif
+    digitalWrite(ctx->nss, level);
+}
+
+static inline uint8_t sx126x_busyRead(sx126x_context* ctx)
+{
+#ifdef __AVR__
+    if (ctx->busyPort) return (*ctx->busyPort & ctx->busyMask) ? HIGH : LOW;
+#endif
+    return digitalRead(ctx->busy);
+}
+
+void sx126x_setSPI(SPIClass &SpiObject, uint32_t frequency, sx126x_context* ctx)
+{
+    ctx->spi = &SpiObject;
+    ctx->spiFrequency = frequency ? frequency : ctx->spiFrequency;
+}
+
+void sx126x_setPins(int8_t nss, int8_t busy, sx126x_context* ctx)
+{
+    ctx->nss = nss;
+    ctx->busy = busy;
+    sx126x_pinCache(ctx);
 }
 
 void sx126x_reset(int8_t reset)
@@ -26,59 +71,190 @@ void sx126x_reset(int8_t reset)
     delayMicroseconds(100);
 }
 
-void sx126x_begin()
+void sx126x_begin(sx126x_context* ctx)
+{
+    pinMode(ctx->nss, OUTPUT);
+    pinMode(ctx->busy, INPUT);
+    sx126x_pinCache(ctx);
+    ctx->spi->begin();
+}
+
+void sx126x_setAsyncTransfer(bool (*asyncTransfer)(uint8_t* txBuf, uint8_t* rxBuf, uint16_t length))
+{
+    sx126x_asyncWait();
+    sx126x_asyncTransfer = asyncTransfer;
+}
+
+void sx126x_onAsyncIdle(void(*callback)())
+{
+    sx126x_asyncIdle = callback;
+}
+
+bool sx126x_asyncBusy()
 {
-    pinMode(sx126x_nss, OUTPUT);
-    pinMode(sx126x_busy, INPUT);
-    sx126x_spi->begin();
+    return sx126x_asyncPending;
 }
 
-bool sx126x_busyCheck(uint32_t timeout)
+bool sx126x_asyncWait(uint32_t timeout)
 {
+    if (!sx126x_asyncPending) return false;
+
+    // transfer routine never finished, release SPI bus without calling transfer callback so next transfer can start
+    uint32_t t = millis();
+    while (sx126x_asyncPending) {
+        if (millis() - t > timeout) {
+            sx126x_asyncContext->spi->endTransaction();
+            sx126x_nssWrite(sx126x_asyncContext, HIGH);
+            sx126x_asyncPending = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+void sx126x_asyncDone()
+{
+    // finish asynchronous transfer, must be called by asynchronous transfer routine when complete
+    sx126x_asyncContext->spi->endTransaction();
+    sx126x_nssWrite(sx126x_asyncContext, HIGH);
+    sx126x_asyncPending = false;
+    if (sx126x_asyncCallback) sx126x_asyncCallback();
+    if (sx126x_asyncIdle && !sx126x_asyncPending) sx126x_asyncIdle();
+}
+
+void sx126x_onBusy(void(*callback)(uint8_t opCode, uint32_t waitTime), sx126x_context* ctx)
+{
+    ctx->onBusy = callback;
+}
+
+bool sx126x_busyCheck(uint32_t timeout, sx126x_context* ctx)
+{
+    // device usually already ready so only one pin read needed
+    if (sx126x_busyRead(ctx) == LOW) return false;
+
+    // spin shortly for short busy period then check timeout, no yield since also called from interrupt handler
+    uint32_t start = micros();
     uint32_t t = millis();
-    while (digitalRead(sx126x_busy) == HIGH) if (millis() - t > timeout) return true;
+    uint8_t spin = SX126X_BUSY_SPIN;
+    while (sx126x_busyRead(ctx) == HIGH) {
+        if (spin) {
+            spin--;
+            continue;
+        }
+        if (millis() - t > timeout) return true;
+    }
+
+    // report busy wait time caused by previous command
+    if (ctx->onBusy) ctx->onBusy(ctx->opCode, micros() - start);
     return false;
 }
 
-void sx126x_setSleep(uint8_t sleepConfig)
+void sx126x_beginBatch(uint8_t* buffer, uint16_t size, sx126x_context* ctx)
 {
-    sx126x_transfer(0x84, &sleepConfig, 1);
+    // record following write commands in buffer instead of sending them
+    sx126x_flushBatch(ctx);
+    ctx->batchBuf = buffer;
+    ctx->batchSize = size;
+    ctx->batchLen = 0;
 }
 
-void sx126x_setStandby(uint8_t standbyConfig)
+uint32_t sx126x_endBatch(sx126x_context* ctx)
 {
-    sx126x_transfer(0x80, &standbyConfig, 1);
+    uint32_t time = sx126x_flushBatch(ctx);
+    ctx->batchBuf = NULL;
+    return time;
+}
+
+uint32_t sx126x_flushBatch(sx126x_context* ctx)
+{
+    if (ctx->batchBuf == NULL || ctx->batchLen == 0) return 0;
+    if (sx126x_asyncWait()) {
+        ctx->batchLen = 0;
+        return SX126X_BATCH_FAILED;
+    }
+    uint32_t start = micros();
+
+    // send recorded commands back to back in one SPI transaction, only wait busy pin between commands
+    ctx->spi->beginTransaction(SPISettings(ctx->spiFrequency, MSBFIRST, SPI_MODE0));
+    uint16_t i = 0;
+    while (i < ctx->batchLen) {
+        uint8_t n = ctx->batchBuf[i++];
+        uint8_t opCode = ctx->batchBuf[i];
+        if (sx126x_busyCheck(SX126X_BUSY_TIMEOUT, ctx)) break;
+        sx126x_nssWrite(ctx, LOW);
+        ctx->spi->transfer(ctx->batchBuf + i, n);
+        sx126x_nssWrite(ctx, HIGH);
+        ctx->opCode = opCode;
+        i += n;
+    }
+    ctx->spi->endTransaction();
+
+    // report remaining commands dropped when device stay busy
+    bool dropped = i < ctx->batchLen;
+    ctx->batchLen = 0;
+    return dropped ? SX126X_BATCH_FAILED : micros() - start;
 }
 
-void sx126x_setFs()
+static bool sx126x_batchRecord(uint8_t opCode, uint8_t* address, uint8_t nAddress, uint8_t* data, uint8_t nData, sx126x_context* ctx)
 {
-    sx126x_transfer(0xC1, NULL, 0);
+    if (ctx->batchBuf == NULL) return false;
+    // command which read from device need recorded commands sent first
+    if ((opCode >= 0x10 && opCode <= 0x1F) || opCode == 0xC0) {
+        sx126x_flushBatch(ctx);
+        return false;
+    }
+    // store command as length byte followed by opcode, address, and data, send directly when too long
+    uint16_t n = 1 + nAddress + nData;
+    if (ctx->batchLen + n + 1 > ctx->batchSize) sx126x_flushBatch(ctx);
+    if (n > 0xFF || n + 1 > ctx->batchSize) return false;
+    uint8_t* buf = ctx->batchBuf + ctx->batchLen;
+    buf[0] = n;
+    buf[1] = opCode;
+    memcpy(buf + 2, address, nAddress);
+    memcpy(buf + 2 + nAddress, data, nData);
+    ctx->batchLen += n + 1;
+    return true;
 }
 
-void sx126x_setTx(uint32_t timeout)
+void sx126x_setSleep(uint8_t sleepConfig, sx126x_context* ctx)
+{
+    sx126x_transfer(0x84, &sleepConfig, 1, ctx);
+}
+
+void sx126x_setStandby(uint8_t standbyConfig, sx126x_context* ctx)
+{
+    sx126x_transfer(0x80, &standbyConfig, 1, ctx);
+}
+
+void sx126x_setFs(sx126x_context* ctx)
+{
+    sx126x_transfer(0xC1, NULL, 0, ctx);
+}
+
+void sx126x_setTx(uint32_t timeout, sx126x_context* ctx)
 {
     uint8_t buf[3];
     buf[0] = timeout >> 16;
     buf[1] = timeout >> 8;
     buf[2] = timeout;
-    sx126x_transfer(0x83, buf, 3);
+    sx126x_transfer(0x83, buf, 3, ctx);
 }
 
-void sx126x_setRx(uint32_t timeout)
+void sx126x_setRx(uint32_t timeout, sx126x_context* ctx)
 {
     uint8_t buf[3];
     buf[0] = timeout >> 16;
     buf[1] = timeout >> 8;
     buf[2] = timeout;
-    sx126x_transfer(0x82, buf, 3);
+    sx126x_transfer(0x82, buf, 3, ctx);
 }
 
-void sx126x_stopTimerOnPreamble(uint8_t enable)
+void sx126x_stopTimerOnPreamble(uint8_t enable, sx126x_context* ctx)
 {
-    sx126x_transfer(0x9F, &enable, 1);
+    sx126x_transfer(0x9F, &enable, 1, ctx);
 }
 
-void sx126x_setRxDutyCycle(uint32_t rxPeriod, uint32_t sleepPeriod)
+void sx126x_setRxDutyCycle(uint32_t rxPeriod, uint32_t sleepPeriod, sx126x_context* ctx)
 {
     uint8_t buf[6];
     buf[0] = rxPeriod >> 16;
@@ -87,96 +263,114 @@ void sx126x_setRxDutyCycle(uint32_t rxPeriod, uint32_t sleepPeriod)
     buf[3] = sleepPeriod >> 16;
     buf[4] = sleepPeriod >> 8;
     buf[5] = sleepPeriod;
-    sx126x_transfer(0x94, buf, 6);
+    sx126x_transfer(0x94, buf, 6, ctx);
 }
 
-void sx126x_setCad()
+void sx126x_setCad(sx126x_context* ctx)
 {
-    sx126x_transfer(0xC5, NULL, 0);
+    sx126x_transfer(0xC5, NULL, 0, ctx);
 }
 
-void sx126x_setTxContinuousWave()
+void sx126x_setTxContinuousWave(sx126x_context* ctx)
 {
-    sx126x_transfer(0xD1, NULL, 0);
+    sx126x_transfer(0xD1, NULL, 0, ctx);
 }
 
-void sx126x_setTxInfinitePreamble()
+void sx126x_setTxInfinitePreamble(sx126x_context* ctx)
 {
-    sx126x_transfer(0xD2, NULL, 0);
+    sx126x_transfer(0xD2, NULL, 0, ctx);
 }
 
-void sx126x_setRegulatorMode(uint8_t modeParam)
+void sx126x_setRegulatorMode(uint8_t modeParam, sx126x_context* ctx)
 {
-    sx126x_transfer(0x96, &modeParam, 1);
+    sx126x_transfer(0x96, &modeParam, 1, ctx);
 }
 
-void sx126x_calibrate(uint8_t calibParam)
+void sx126x_calibrate(uint8_t calibParam, sx126x_context* ctx)
 {
-    sx126x_transfer(0x89, &calibParam, 1);
+    sx126x_transfer(0x89, &calibParam, 1, ctx);
 }
 
-void sx126x_calibrateImage(uint8_t freq1, uint8_t freq2)
+void sx126x_calibrateImage(uint8_t freq1, uint8_t freq2, sx126x_context* ctx)
 {
     uint8_t buf[2];
     buf[0] = freq1;
     buf[1] = freq2;
-    sx126x_transfer(0x98, buf, 2);
+    sx126x_transfer(0x98, buf, 2, ctx);
 }
 
-void sx126x_setPaConfig(uint8_t paDutyCycle, uint8_t hpMax, uint8_t deviceSel, uint8_t paLut)
+void sx126x_setPaConfig(uint8_t paDutyCycle, uint8_t hpMax, uint8_t deviceSel, uint8_t paLut, sx126x_context* ctx)
 {
     uint8_t buf[4];
     buf[0] = paDutyCycle;
     buf[1] = hpMax;
     buf[2] = deviceSel;
     buf[3] = paLut;
-    sx126x_transfer(0x95, buf, 4);
+    sx126x_transfer(0x95, buf, 4, ctx);
 }
 
-void sx126x_setRxTxFallbackMode(uint8_t fallbackMode)
+void sx126x_setRxTxFallbackMode(uint8_t fallbackMode, sx126x_context* ctx)
 {
-    sx126x_transfer(0x93, &fallbackMode, 1);
+    sx126x_transfer(0x93, &fallbackMode, 1, ctx);
 }
 
-void sx126x_writeRegister(uint16_t address, uint8_t* data, uint8_t nData)
+void sx126x_writeRegister(uint16_t address, uint8_t* data, uint8_t nData, sx126x_context* ctx)
 {
-    uint8_t nBuf = nData + 2;
-    uint8_t buf[nBuf];
-    buf[0] = address >> 8;
-    buf[1] = address;
-    for(uint8_t i=0; i<nData; i++) buf[i + 2] = data[i];
-    sx126x_transfer(0x0D, buf, nBuf);
+    uint8_t addr[2];
+    addr[0] = address >> 8;
+    addr[1] = address;
+    sx126x_writeBytes(0x0D, addr, 2, data, nData, ctx);
 }
 
-void sx126x_readRegister(uint16_t address, uint8_t* data, uint8_t nData)
+void sx126x_readRegister(uint16_t address, uint8_t* data, uint8_t nData, sx126x_context* ctx)
 {
-    uint8_t nBuf = nData + 1;
-    uint8_t buf[nBuf];
     uint8_t addr[2];
     addr[0] = address >> 8;
     addr[1] = address;
-    sx126x_transfer(0x1D, buf, nBuf, addr, 2);
-    for(uint8_t i=0; i<nData; i++) data[i] = buf[i + 1];
+    sx126x_readBytes(0x1D, addr, 2, data, nData, ctx);
 }
 
-void sx126x_writeBuffer(uint8_t offset, uint8_t* data, uint8_t nData)
+void sx126x_writeBuffer(uint8_t offset, uint8_t* data, uint8_t nData, sx126x_context* ctx)
 {
-    uint8_t nBuf = nData + 1;
-    uint8_t buf[nBuf];
-    buf[0] = offset;
-    for(uint8_t i=0; i<nData; i++) buf[i + 1] = data[i];
-    sx126x_transfer(0x0E, buf, nBuf);
+    sx126x_writeBytes(0x0E, &offset, 1, data, nData, ctx);
 }
 
-void sx126x_readBuffer(uint8_t offset, uint8_t* data, uint8_t nData)
+void sx126x_readBuffer(uint8_t offset, uint8_t* data, uint8_t nData, sx126x_context* ctx)
 {
-    uint8_t nBuf = nData + 1;
-    uint8_t buf[nBuf];
-    sx126x_transfer(0x1E, buf, nBuf, &offset, 1);
-    for(uint8_t i=0; i<nData; i++) data[i] = buf[i + 1];
+    sx126x_readBytes(0x1E, &offset, 1, data, nData, ctx);
 }
 
-void sx126x_setDioIrqParams(uint16_t irqMask, uint16_t dio1Mask, uint16_t dio2Mask, uint16_t dio3Mask)
+void sx126x_writeBufferv(uint8_t offset, const LoRaSegment* segments, uint8_t count, sx126x_context* ctx)
+{
+    // send recorded commands first then write all segments in one chip select window
+    sx126x_flushBatch(ctx);
+    sx126x_asyncWait();
+    if (sx126x_busyCheck(SX126X_BUSY_TIMEOUT, ctx)) return;
+
+    // segment data transferred byte by byte so caller buffer not overwritten with received bytes
+    sx126x_nssWrite(ctx, LOW);
+    ctx->spi->beginTransaction(SPISettings(ctx->spiFrequency, MSBFIRST, SPI_MODE0));
+    ctx->spi->transfer(0x0E);
+    ctx->spi->transfer(offset);
+    for (uint8_t i=0; i<count; i++) {
+        for (uint8_t j=0; j<segments[i].length; j++) ctx->spi->transfer(segments[i].data[j]);
+    }
+    ctx->spi->endTransaction();
+    sx126x_nssWrite(ctx, HIGH);
+    ctx->opCode = 0x0E;
+}
+
+bool sx126x_writeBufferAsync(uint8_t offset, uint8_t* data, uint8_t nData, void(*callback)(), sx126x_context* ctx)
+{
+    return sx126x_transferAsync(0x0E, &offset, 1, data, NULL, nData, callback, ctx);
+}
+
+bool sx126x_readBufferAsync(uint8_t offset, uint8_t* data, uint8_t nData, void(*callback)(), sx126x_context* ctx)
+{
+    return sx126x_transferAsync(0x1E, &offset, 1, NULL, data, nData, callback, ctx);
+}
+
+void sx126x_setDioIrqParams(uint16_t irqMask, uint16_t dio1Mask, uint16_t dio2Mask, uint16_t dio3Mask, sx126x_context* ctx)
 {
     uint8_t buf[8];
     buf[0] = irqMask >> 8;
@@ -187,80 +381,80 @@ void sx126x_setDioIrqParams(uint16_t irqMask, uint16_t dio1Mask, uint16_t dio2Ma
     buf[5] = dio2Mask;
     buf[6] = dio3Mask >> 8;
     buf[7] = dio3Mask;
-    sx126x_transfer(0x08, buf, 8);
+    sx126x_transfer(0x08, buf, 8, ctx);
 }
 
-void sx126x_getIrqStatus(uint16_t* irqStatus)
+void sx126x_getIrqStatus(uint16_t* irqStatus, sx126x_context* ctx)
 {
     uint8_t buf[3];
-    sx126x_transfer(0x12, buf, 3);
+    sx126x_transfer(0x12, buf, 3, ctx);
     *irqStatus = (buf[1] << 8) | buf[2];
 }
 
-void sx126x_clearIrqStatus(uint16_t clearIrqParam)
+void sx126x_clearIrqStatus(uint16_t clearIrqParam, sx126x_context* ctx)
 {
     uint8_t buf[2];
     buf[0] = clearIrqParam >> 8;
     buf[1] = clearIrqParam;
-    sx126x_transfer(0x02, buf, 2);
+    sx126x_transfer(0x02, buf, 2, ctx);
 }
 
-void sx126x_setDio2AsRfSwitchCtrl(uint8_t enable)
+void sx126x_setDio2AsRfSwitchCtrl(uint8_t enable, sx126x_context* ctx)
 {
-    sx126x_transfer(0x9D, &enable, 1);
+    sx126x_transfer(0x9D, &enable, 1, ctx);
 }
 
-void sx126x_setDio3AsTcxoCtrl(uint8_t tcxoVoltage, uint32_t delay)
+void sx126x_setDio3AsTcxoCtrl(uint8_t tcxoVoltage, uint32_t delay, sx126x_context* ctx)
 {
     uint8_t buf[4];
     buf[0] = tcxoVoltage;
     buf[1] = delay >> 16;
     buf[2] = delay >> 8;
     buf[3] = delay;
-    sx126x_transfer(0x97, buf, 4);
+    sx126x_transfer(0x97, buf, 4, ctx);
 }
 
-void sx126x_setRfFrequency(uint32_t rfFreq)
+void sx126x_setRfFrequency(uint32_t rfFreq, sx126x_context* ctx)
 {
     uint8_t buf[4];
     buf[0] = rfFreq >> 24;
     buf[1] = rfFreq >> 16;
     buf[2] = rfFreq >> 8;
     buf[3] = rfFreq;
-    sx126x_transfer(0x86, buf, 4);
+    sx126x_transfer(0x86, buf, 4, ctx);
 }
 
-void sx126x_setPacketType(uint8_t packetType)
+void sx126x_setPacketType(uint8_t packetType, sx126x_context* ctx)
 {
-    sx126x_transfer(0x8A, &packetType, 1);
+    sx126x_transfer(0x8A, &packetType, 1, ctx);
 }
 
-void sx126x_getPacketType(uint8_t* packetType)
+void sx126x_getPacketType(uint8_t* packetType, sx126x_context* ctx)
 {
     uint8_t buf[2];
-    sx126x_transfer(0x11, buf, 2);
+    sx126x_transfer(0x11, buf, 2, ctx);
     *packetType = buf[1];
 }
 
-void sx126x_setTxParams(uint8_t power, uint8_t rampTime)
+void sx126x_setTxParams(uint8_t power, uint8_t rampTime, sx126x_context* ctx)
 {
     uint8_t buf[2];
     buf[0] = power;
     buf[1] = rampTime;
-    sx126x_transfer(0x8E, buf, 2);
+    sx126x_transfer(0x8E, buf, 2, ctx);
 }
 
-void sx126x_setModulationParamsLoRa(uint8_t sf, uint8_t bw, uint8_t cr, uint8_t ldro)
+void sx126x_setModulationParamsLoRa(uint8_t sf, uint8_t bw, uint8_t cr, uint8_t ldro, sx126x_context* ctx)
 {
     uint8_t buf[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
     buf[0] = sf;
     buf[1] = bw;
     buf[2] = cr;
     buf[3] = ldro;
-    sx126x_transfer(0x8B, buf, 8);
+    sx126x_transfer(0x8B, buf, 8, ctx);
 }
 
-void sx126x_setModulationParamsFSK(uint32_t br, uint8_t pulseShape, uint8_t bandwidth, uint32_t Fdev)
+void sx126x_setModulationParamsFSK(uint32_t br, uint8_t pulseShape, uint8_t bandwidth, uint32_t Fdev, sx126x_context* ctx)
 {
     uint8_t buf[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
     buf[0] = br >> 16;
@@ -271,10 +465,10 @@ void sx126x_setModulationParamsFSK(uint32_t br, uint8_t pulseShape, uint8_t band
     buf[5] = Fdev >> 16;
     buf[6] = Fdev >> 8;
     buf[7] = Fdev;
-    sx126x_transfer(0x8B, buf, 8);
+    sx126x_transfer(0x8B, buf, 8, ctx);
 }
 
-void sx126x_setPacketParamsLoRa(uint16_t preambleLength, uint8_t headerType, uint8_t payloadLength, uint8_t crcType, uint8_t invertIq)
+void sx126x_setPacketParamsLoRa(uint16_t preambleLength, uint8_t headerType, uint8_t payloadLength, uint8_t crcType, uint8_t invertIq, sx126x_context* ctx)
 {
     uint8_t buf[9] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
     buf[0] = preambleLength >> 8;
@@ -283,10 +477,10 @@ void sx126x_setPacketParamsLoRa(uint16_t preambleLength, uint8_t headerType, uin
     buf[3] = payloadLength;
     buf[4] = crcType;
     buf[5] = invertIq;
-    sx126x_transfer(0x8C, buf, 9);
+    sx126x_transfer(0x8C, buf, 9, ctx);
 }
 
-void sx126x_setPacketParamsFSK(uint16_t preambleLength, uint8_t preambleDetector, uint8_t syncWordLength, uint8_t addrComp, uint8_t packetType, uint8_t payloadLength, uint8_t crcType, uint8_t whitening)
+void sx126x_setPacketParamsFSK(uint16_t preambleLength, uint8_t preambleDetector, uint8_t syncWordLength, uint8_t addrComp, uint8_t packetType, uint8_t payloadLength, uint8_t crcType, uint8_t whitening, sx126x_context* ctx)
 {
     uint8_t buf[9] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
     buf[0] = preambleLength >> 8;
@@ -298,10 +492,10 @@ void sx126x_setPacketParamsFSK(uint16_t preambleLength, uint8_t preambleDetector
     buf[6] = payloadLength;
     buf[7] = crcType;
     buf[8] = whitening;
-    sx126x_transfer(0x8C, buf, 9);
+    sx126x_transfer(0x8C, buf, 9, ctx);
 }
 
-void sx126x_setCadParams(uint8_t cadSymbolNum, uint8_t cadDetPeak, uint8_t cadDetMin, uint8_t cadExitMode, uint32_t cadTimeout)
+void sx126x_setCadParams(uint8_t cadSymbolNum, uint8_t cadDetPeak, uint8_t cadDetMin, uint8_t cadExitMode, uint32_t cadTimeout, sx126x_context* ctx)
 {
     uint8_t buf[7];
     buf[0] = cadSymbolNum;
@@ -311,132 +505,188 @@ void sx126x_setCadParams(uint8_t cadSymbolNum, uint8_t cadDetPeak, uint8_t cadDe
     buf[4] = cadTimeout >> 16;
     buf[5] = cadTimeout >> 8;
     buf[6] = cadTimeout;
-    sx126x_transfer(0x88, buf, 7);
+    sx126x_transfer(0x88, buf, 7, ctx);
 }
 
-void sx126x_setBufferBaseAddress(uint8_t txBaseAddress, uint8_t rxBaseAddress)
+void sx126x_setBufferBaseAddress(uint8_t txBaseAddress, uint8_t rxBaseAddress, sx126x_context* ctx)
 {
     uint8_t buf[2];
     buf[0] = txBaseAddress;
     buf[1] = rxBaseAddress;
-    sx126x_transfer(0x8F, buf, 2);
+    sx126x_transfer(0x8F, buf, 2, ctx);
 }
 
-void sx126x_setLoRaSymbNumTimeout(uint8_t symbnum)
+void sx126x_setLoRaSymbNumTimeout(uint8_t symbnum, sx126x_context* ctx)
 {
-    sx126x_transfer(0xA0, &symbnum, 1);
+    sx126x_transfer(0xA0, &symbnum, 1, ctx);
 }
         
-void sx126x_getStatus(uint8_t* status)
+void sx126x_getStatus(uint8_t* status, sx126x_context* ctx)
 {
     uint8_t buf;
-    sx126x_transfer(0xC0, &buf, 1);
+    sx126x_transfer(0xC0, &buf, 1, ctx);
     *status = buf;
 }
 
-void sx126x_getRxBufferStatus(uint8_t* payloadLengthRx, uint8_t* rxStartBufferPointer)
+void sx126x_getRxBufferStatus(uint8_t* payloadLengthRx, uint8_t* rxStartBufferPointer, sx126x_context* ctx)
 {
     uint8_t buf[3];
-    sx126x_transfer(0x13, buf, 3);
+    sx126x_transfer(0x13, buf, 3, ctx);
     *payloadLengthRx = buf[1];
     *rxStartBufferPointer = buf[2];
 }
 
-void sx126x_getPacketStatus(uint8_t* rssiPkt, uint8_t* snrPkt, uint8_t* signalRssiPkt)
+void sx126x_getPacketStatus(uint8_t* rssiPkt, uint8_t* snrPkt, uint8_t* signalRssiPkt, sx126x_context* ctx)
 {
     uint8_t buf[4];
-    sx126x_transfer(0x14, buf, 4);
+    sx126x_transfer(0x14, buf, 4, ctx);
     *rssiPkt = buf[1];
     *snrPkt = buf[2];
     *signalRssiPkt = buf[3];
 }
 
-void sx126x_getRssiInst(uint8_t* rssiInst)
+void sx126x_getRssiInst(uint8_t* rssiInst, sx126x_context* ctx)
 {
     uint8_t buf[2];
-    sx126x_transfer(0x15, buf, 2);
+    sx126x_transfer(0x15, buf, 2, ctx);
     *rssiInst = buf[1];
 }
 
-void sx126x_getStats(uint16_t* nbPktReceived, uint16_t* nbPktCrcError, uint16_t* nbPktHeaderErr)
+void sx126x_getStats(uint16_t* nbPktReceived, uint16_t* nbPktCrcError, uint16_t* nbPktHeaderErr, sx126x_context* ctx)
 {
     uint8_t buf[7];
-    sx126x_transfer(0x10, buf, 7);
+    sx126x_transfer(0x10, buf, 7, ctx);
     *nbPktReceived = (buf[1] >> 8) | buf[2];
     *nbPktCrcError = (buf[3] >> 8) | buf[4];
     *nbPktHeaderErr = (buf[5] >> 8) | buf[6];
 }
 
-void sx126x_resetStats()
+void sx126x_resetStats(sx126x_context* ctx)
 {
     uint8_t buf[6] = {0, 0, 0, 0, 0, 0};
-    sx126x_transfer(0x00, buf, 6);
+    sx126x_transfer(0x00, buf, 6, ctx);
 }
 
-void sx126x_getDeviceErrors(uint16_t* opError)
+void sx126x_getDeviceErrors(uint16_t* opError, sx126x_context* ctx)
 {
     uint8_t buf[3];
-    sx126x_transfer(0x17, buf, 3);
+    sx126x_transfer(0x17, buf, 3, ctx);
     *opError = buf[2];
 }
 
-void sx126x_clearDeviceErrors()
+void sx126x_clearDeviceErrors(sx126x_context* ctx)
 {
     uint8_t buf[2] = {0, 0};
-    sx126x_transfer(0x07, buf, 2);
+    sx126x_transfer(0x07, buf, 2, ctx);
 }
 
-void sx126x_fixLoRaBw500(uint32_t bw)
+void sx126x_fixLoRaBw500(uint32_t bw, sx126x_context* ctx)
 {
     uint8_t packetType;
-    sx126x_getPacketType(&packetType);
+    sx126x_getPacketType(&packetType, ctx);
     uint8_t value;
-    sx126x_readRegister(SX126X_REG_TX_MODULATION, &value, 1);
+    sx126x_readRegister(SX126X_REG_TX_MODULATION, &value, 1, ctx);
     if ((packetType == SX126X_LORA_MODEM) && (bw == 500000)) value &= 0xFB;
     else value |= 0x04;
-    sx126x_writeRegister(SX126X_REG_TX_MODULATION, &value, 1);
+    sx126x_writeRegister(SX126X_REG_TX_MODULATION, &value, 1, ctx);
 }
 
-void sx126x_fixResistanceAntenna()
+void sx126x_fixResistanceAntenna(sx126x_context* ctx)
 {
     uint8_t value;
-    sx126x_readRegister(SX126X_REG_TX_CLAMP_CONFIG, &value, 1);
+    sx126x_readRegister(SX126X_REG_TX_CLAMP_CONFIG, &value, 1, ctx);
     value |= 0x1E;
-    sx126x_writeRegister(SX126X_REG_TX_CLAMP_CONFIG, &value, 1);
+    sx126x_writeRegister(SX126X_REG_TX_CLAMP_CONFIG, &value, 1, ctx);
 }
 
-void sx126x_fixRxTimeout()
+void sx126x_fixRxTimeout(sx126x_context* ctx)
 {
     uint8_t value = 0x00;
-    sx126x_writeRegister(SX126X_REG_RTC_CONTROL, &value, 1);
-    sx126x_readRegister(SX126X_REG_EVENT_MASK, &value, 1);
+    sx126x_writeRegister(SX126X_REG_RTC_CONTROL, &value, 1, ctx);
+    sx126x_readRegister(SX126X_REG_EVENT_MASK, &value, 1, ctx);
     value = value | 0x02;
-    sx126x_writeRegister(SX126X_REG_EVENT_MASK, &value, 1);
+    sx126x_writeRegister(SX126X_REG_EVENT_MASK, &value, 1, ctx);
 }
 
-void sx126x_fixInvertedIq(uint8_t invertIq)
+void sx126x_fixInvertedIq(uint8_t invertIq, sx126x_context* ctx)
 {
     uint8_t value;
-    sx126x_readRegister(SX126X_REG_IQ_POLARITY_SETUP, &value, 1);
+    sx126x_readRegister(SX126X_REG_IQ_POLARITY_SETUP, &value, 1, ctx);
     if (invertIq) value |= 0x04;
     else value &= 0xFB;
-    sx126x_writeRegister(SX126X_REG_IQ_POLARITY_SETUP, &value, 1);
+    sx126x_writeRegister(SX126X_REG_IQ_POLARITY_SETUP, &value, 1, ctx);
 }
 
-void sx126x_transfer(uint8_t opCode, uint8_t* data, uint8_t nBytes)
+void sx126x_transfer(uint8_t opCode, uint8_t* data, uint8_t nBytes, sx126x_context* ctx)
 {
-    sx126x_transfer(opCode, data, nBytes, NULL, 0);
+    sx126x_transfer(opCode, data, nBytes, NULL, 0, ctx);
 }
 
-void sx126x_transfer(uint8_t opCode, uint8_t* data, uint8_t nBytes, uint8_t* address, uint8_t nAddress)
+void sx126x_transfer(uint8_t opCode, uint8_t* data, uint8_t nBytes, uint8_t* address, uint8_t nAddress, sx126x_context* ctx)
 {
-    if (sx126x_busyCheck(SX126X_BUSY_TIMEOUT)) return;
+    if (sx126x_batchRecord(opCode, address, nAddress, data, nBytes, ctx)) return;
+    sx126x_asyncWait();
+    if (sx126x_busyCheck(SX126X_BUSY_TIMEOUT, ctx)) return;
+
+    sx126x_nssWrite(ctx, LOW);
+    ctx->spi->beginTransaction(SPISettings(ctx->spiFrequency, MSBFIRST, SPI_MODE0));
+    ctx->spi->transfer(opCode);
+    for (uint8_t i=0; i<nAddress; i++) ctx->spi->transfer(address[i]);
+    if (nBytes) ctx->spi->transfer(data, nBytes);
+    ctx->spi->endTransaction();
+    sx126x_nssWrite(ctx, HIGH);
+    ctx->opCode = opCode;
+}
+
+void sx126x_writeBytes(uint8_t opCode, uint8_t* address, uint8_t nAddress, uint8_t* data, uint8_t nData, sx126x_context* ctx)
+{
+    sx126x_transferAsync(opCode, address, nAddress, data, NULL, nData, NULL, ctx);
+    sx126x_asyncWait();
+}
+
+void sx126x_readBytes(uint8_t opCode, uint8_t* address, uint8_t nAddress, uint8_t* data, uint8_t nData, sx126x_context* ctx)
+{
+    sx126x_transferAsync(opCode, address, nAddress, NULL, data, nData, NULL, ctx);
+    sx126x_asyncWait();
+}
+
+bool sx126x_transferAsync(uint8_t opCode, uint8_t* address, uint8_t nAddress, uint8_t* txBuf, uint8_t* rxBuf, uint8_t nData, void(*callback)(), sx126x_context* ctx)
+{
+    // record write command when batch active, commands with callback or read data sent after recorded commands
+    if (callback || rxBuf) sx126x_flushBatch(ctx);
+    else if (sx126x_batchRecord(opCode, address, nAddress, txBuf, nData, ctx)) return true;
+
+    // previous asynchronous transfer must be finished before starting new one
+    if (sx126x_asyncWait()) return false;
+    if (sx126x_busyCheck(SX126X_BUSY_TIMEOUT, ctx)) return false;
+
+    // send opcode, address header, and NOP for status byte of read command
+    sx126x_nssWrite(ctx, LOW);
+    ctx->spi->beginTransaction(SPISettings(ctx->spiFrequency, MSBFIRST, SPI_MODE0));
+    ctx->spi->transfer(opCode);
+    for (uint8_t i=0; i<nAddress; i++) ctx->spi->transfer(address[i]);
+    if (rxBuf) ctx->spi->transfer(0x00);
+
+    // stream data with asynchronous transfer routine, transfer finished when it calls sx126x_asyncDone()
+    ctx->opCode = opCode;
+    sx126x_asyncContext = ctx;
+    sx126x_asyncCallback = callback;
+    sx126x_asyncPending = true;
+    if (sx126x_asyncTransfer && nData) {
+        if (sx126x_asyncTransfer(txBuf, rxBuf, nData)) return true;
+    }
 
-    digitalWrite(sx126x_nss, LOW);
-    sx126x_spi->beginTransaction(SPISettings(sx126x_spiFrequency, MSBFIRST, SPI_MODE0));
-    sx126x_spi->transfer(opCode);
-    for (int8_t i=0; i<nAddress; i++) sx126x_spi->transfer(address[i]);
-    for (int8_t i=0; i<nBytes; i++) data[i] = sx126x_spi->transfer(data[i]);
-    sx126x_spi->endTransaction();
-    digitalWrite(sx126x_nss, HIGH);
+    // fallback to blocking transfer directly from or into caller buffer
+    if (rxBuf && nData) {
+        memset(rxBuf, 0x00, nData);
+        ctx->spi->transfer(rxBuf, nData);
+    } else if (txBuf) {
+#if defined(ESP32) || defined(ESP8266)
+        ctx->spi->writeBytes(txBuf, nData);
+#else
+        for (uint8_t i=0; i<nData; i++) ctx->spi->transfer(txBuf[i]);
+#endif
+    }
+    sx126x_asyncDone();
+    return true;
 }
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <SPI.h>
+#include <BaseLoRa.h>
 
 // SX126X register map
 #define SX126X_REG_FSK_WHITENING_INITIAL_MSB    0x06B8
@@ -239,75 +240,126 @@
 #else
     #define SX126X_SPI_FREQUENCY                16000000    // Maximum LoRa SPI frequency
 #endif
+#define SX126X_ASYNC_TIMEOUT                    100         // Default timeout for asynchronous transfer to finish
 #define SX126X_BUSY_TIMEOUT                     5000        // Default timeout for checking busy pin
+#define SX126X_BUSY_SPIN                        64          // Busy pin reads before checking timeout
+#define SX126X_BATCH_FAILED                     0xFFFFFFFF  // Batch flush result when recorded commands dropped
+
+// SPI bus and pins used by driver functions, one context for each radio
+struct sx126x_context {
+    SPIClass* spi;
+    uint32_t spiFrequency;
+    int8_t nss;
+    int8_t busy;
+    uint8_t opCode;                                 // last command sent, busy wait after it reported to onBusy
+    void (*onBusy)(uint8_t opCode, uint32_t waitTime);
+    uint8_t* batchBuf;                              // command batch buffer, commands sent directly when NULL
+    uint16_t batchSize;
+    uint16_t batchLen;
+#ifdef __AVR__
+    volatile uint8_t* nssPort;                      // cached port register and bit mask for direct pin access
+    volatile uint8_t* busyPort;
+    uint8_t nssMask;
+    uint8_t busyMask;
+#endif
+};
+
+extern sx126x_context sx126x_defaultContext;
+// Context used by driver functions called without context, point to default context until changed e.g. by setActive()
+extern sx126x_context* sx126x_activeContext;
 
-void sx126x_setSPI(SPIClass &SpiObject, uint32_t frequency);
-void sx126x_setPins(int8_t nss, int8_t busy);
+void sx126x_setSPI(SPIClass &SpiObject, uint32_t frequency, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setPins(int8_t nss, int8_t busy, sx126x_context* ctx=sx126x_activeContext);
 void sx126x_reset(int8_t reset);
-void sx126x_begin();
-bool sx126x_busyCheck(uint32_t timeout=SX126X_BUSY_TIMEOUT);
+void sx126x_begin(sx126x_context* ctx=sx126x_activeContext);
+bool sx126x_busyCheck(uint32_t timeout=SX126X_BUSY_TIMEOUT, sx126x_context* ctx=sx126x_activeContext);
+// Callback called with opcode of previous command and busy wait time in microsecond every time busy pin found high
+void sx126x_onBusy(void(*callback)(uint8_t opCode, uint32_t waitTime), sx126x_context* ctx=sx126x_activeContext);
+
+// Asynchronous transfer routine (e.g. DMA) start streaming length bytes from txBuf (0x00 when NULL) and into rxBuf (discarded when NULL)
+// then return true, or return false to use blocking transfer. The routine must call sx126x_asyncDone() when transfer complete
+// Wait return true when transfer not done within timeout in millisecond, the transfer then aborted and SPI bus released
+// Idle callback called after every completed transfer, e.g. to run interrupt handler deferred while transfer used SPI bus
+void sx126x_setAsyncTransfer(bool (*asyncTransfer)(uint8_t* txBuf, uint8_t* rxBuf, uint16_t length));
+void sx126x_onAsyncIdle(void(*callback)());
+bool sx126x_asyncBusy();
+bool sx126x_asyncWait(uint32_t timeout=SX126X_ASYNC_TIMEOUT);
+void sx126x_asyncDone();
+
+// Record write commands in buffer and send them in one SPI transaction on end or flush, read command flush batch first
+// End and flush return time taken to send recorded commands in microsecond, or SX126X_BATCH_FAILED when busy pin or
+// asynchronous transfer timeout and the commands not sent yet dropped
+void sx126x_beginBatch(uint8_t* buffer, uint16_t size, sx126x_context* ctx=sx126x_activeContext);
+uint32_t sx126x_endBatch(sx126x_context* ctx=sx126x_activeContext);
+uint32_t sx126x_flushBatch(sx126x_context* ctx=sx126x_activeContext);
 
 // SX126x driver: Operational Modes Commands
-void sx126x_setSleep(uint8_t sleepConfig);
-void sx126x_setStandby(uint8_t standbyMode);
-void sx126x_setFs();
-void sx126x_setTx(uint32_t timeout);
-void sx126x_setRx(uint32_t timeout);
-void sx126x_stopTimerOnPreamble(uint8_t enable);
-void sx126x_setRxDutyCycle(uint32_t rxPeriod, uint32_t sleepPeriod);
-void sx126x_setCad();
-void sx126x_setTxContinuousWave();
-void sx126x_setTxInfinitePreamble();
-void sx126x_setRegulatorMode(uint8_t modeParam);
-void sx126x_calibrate(uint8_t calibParam);
-void sx126x_calibrateImage(uint8_t freq1, uint8_t freq2);
-void sx126x_setPaConfig(uint8_t paDutyCycle, uint8_t hpMax, uint8_t deviceSel, uint8_t paLut);
-void sx126x_setRxTxFallbackMode(uint8_t fallbackMode);
+void sx126x_setSleep(uint8_t sleepConfig, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setStandby(uint8_t standbyMode, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setFs(sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setTx(uint32_t timeout, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setRx(uint32_t timeout, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_stopTimerOnPreamble(uint8_t enable, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setRxDutyCycle(uint32_t rxPeriod, uint32_t sleepPeriod, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setCad(sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setTxContinuousWave(sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setTxInfinitePreamble(sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setRegulatorMode(uint8_t modeParam, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_calibrate(uint8_t calibParam, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_calibrateImage(uint8_t freq1, uint8_t freq2, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setPaConfig(uint8_t paDutyCycle, uint8_t hpMax, uint8_t deviceSel, uint8_t paLut, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setRxTxFallbackMode(uint8_t fallbackMode, sx126x_context* ctx=sx126x_activeContext);
 
 // SX126x driver: Register and Buffer Access Commands
-void sx126x_writeRegister(uint16_t address, uint8_t* data, uint8_t nData);
-void sx126x_readRegister(uint16_t address, uint8_t* data, uint8_t nData);
-void sx126x_writeBuffer(uint8_t offset, uint8_t* data, uint8_t nData);
-void sx126x_readBuffer(uint8_t offset, uint8_t* data, uint8_t nData);
+void sx126x_writeRegister(uint16_t address, uint8_t* data, uint8_t nData, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_readRegister(uint16_t address, uint8_t* data, uint8_t nData, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_writeBuffer(uint8_t offset, uint8_t* data, uint8_t nData, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_readBuffer(uint8_t offset, uint8_t* data, uint8_t nData, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_writeBufferv(uint8_t offset, const LoRaSegment* segments, uint8_t count, sx126x_context* ctx=sx126x_activeContext);
+bool sx126x_writeBufferAsync(uint8_t offset, uint8_t* data, uint8_t nData, void(*callback)()=NULL, sx126x_context* ctx=sx126x_activeContext);
+bool sx126x_readBufferAsync(uint8_t offset, uint8_t* data, uint8_t nData, void(*callback)()=NULL, sx126x_context* ctx=sx126x_activeContext);
 
 // SX126x driver: DIO and IRQ Control
-void sx126x_setDioIrqParams(uint16_t irqMask, uint16_t dio1Mask, uint16_t dio2Mask, uint16_t dio3Mask);
-void sx126x_getIrqStatus(uint16_t* irqStatus);
-void sx126x_clearIrqStatus(uint16_t clearIrqParam);
-void sx126x_setDio2AsRfSwitchCtrl(uint8_t enable);
-void sx126x_setDio3AsTcxoCtrl(uint8_t tcxoVoltage, uint32_t delay);
+void sx126x_setDioIrqParams(uint16_t irqMask, uint16_t dio1Mask, uint16_t dio2Mask, uint16_t dio3Mask, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_getIrqStatus(uint16_t* irqStatus, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_clearIrqStatus(uint16_t clearIrqParam, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setDio2AsRfSwitchCtrl(uint8_t enable, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setDio3AsTcxoCtrl(uint8_t tcxoVoltage, uint32_t delay, sx126x_context* ctx=sx126x_activeContext);
 
 // SX126x driver: RF, Modulation and Packet Commands
-void sx126x_setRfFrequency(uint32_t rfFrequency);
-void sx126x_setPacketType(uint8_t packetType);
-void sx126x_getPacketType(uint8_t* packetType);
-void sx126x_setTxParams(uint8_t power, uint8_t rampTime);
-void sx126x_setModulationParamsLoRa(uint8_t sf, uint8_t bw, uint8_t cr, uint8_t ldro);
-void sx126x_setModulationParamsFSK(uint32_t br, uint8_t pulseShape, uint8_t bandwidth, uint32_t Fdev);
-void sx126x_setPacketParamsLoRa(uint16_t preambleLength, uint8_t headerType, uint8_t payloadLength, uint8_t crcType, uint8_t invertIq);
-void sx126x_setPacketParamsFSK(uint16_t preambleLength, uint8_t preambleDetector, uint8_t syncWordLength, uint8_t addrComp, uint8_t packetType, uint8_t payloadLength, uint8_t crcType, uint8_t whitening);
-void sx126x_setCadParams(uint8_t cadSymbolNum, uint8_t cadDetPeak, uint8_t cadDetMin, uint8_t cadExitMode, uint32_t cadTimeout);
-void sx126x_setBufferBaseAddress(uint8_t txBaseAddress, uint8_t rxBaseAddress);
-void sx126x_setLoRaSymbNumTimeout(uint8_t symbnum);
+void sx126x_setRfFrequency(uint32_t rfFrequency, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setPacketType(uint8_t packetType, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_getPacketType(uint8_t* packetType, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setTxParams(uint8_t power, uint8_t rampTime, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setModulationParamsLoRa(uint8_t sf, uint8_t bw, uint8_t cr, uint8_t ldro, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setModulationParamsFSK(uint32_t br, uint8_t pulseShape, uint8_t bandwidth, uint32_t Fdev, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setPacketParamsLoRa(uint16_t preambleLength, uint8_t headerType, uint8_t payloadLength, uint8_t crcType, uint8_t invertIq, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setPacketParamsFSK(uint16_t preambleLength, uint8_t preambleDetector, uint8_t syncWordLength, uint8_t addrComp, uint8_t packetType, uint8_t payloadLength, uint8_t crcType, uint8_t whitening, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setCadParams(uint8_t cadSymbolNum, uint8_t cadDetPeak, uint8_t cadDetMin, uint8_t cadExitMode, uint32_t cadTimeout, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setBufferBaseAddress(uint8_t txBaseAddress, uint8_t rxBaseAddress, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_setLoRaSymbNumTimeout(uint8_t symbnum, sx126x_context* ctx=sx126x_activeContext);
 
 // SX126x driver: Status Commands
-void sx126x_getStatus(uint8_t* status);
-void sx126x_getRxBufferStatus(uint8_t* payloadLengthRx, uint8_t* rxStartBufferPointer);
-void sx126x_getPacketStatus(uint8_t* rssiPkt, uint8_t* snrPkt, uint8_t* signalRssiPkt);
-void sx126x_getRssiInst(uint8_t* rssiInst);
-void sx126x_getStats(uint16_t* nbPktReceived, uint16_t* nbPktCrcError, uint16_t* nbPktHeaderErr);
-void sx126x_resetStats();
-void sx126x_getDeviceErrors(uint16_t* opError);
-void sx126x_clearDeviceErrors();
+void sx126x_getStatus(uint8_t* status, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_getRxBufferStatus(uint8_t* payloadLengthRx, uint8_t* rxStartBufferPointer, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_getPacketStatus(uint8_t* rssiPkt, uint8_t* snrPkt, uint8_t* signalRssiPkt, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_getRssiInst(uint8_t* rssiInst, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_getStats(uint16_t* nbPktReceived, uint16_t* nbPktCrcError, uint16_t* nbPktHeaderErr, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_resetStats(sx126x_context* ctx=sx126x_activeContext);
+void sx126x_getDeviceErrors(uint16_t* opError, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_clearDeviceErrors(sx126x_context* ctx=sx126x_activeContext);
 
 // SX126x driver: Workaround functions
-void sx126x_fixLoRaBw500(uint32_t bw);
-void sx126x_fixResistanceAntenna();
-void sx126x_fixRxTimeout();
-void sx126x_fixInvertedIq(uint8_t invertIq);
+void sx126x_fixLoRaBw500(uint32_t bw, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_fixResistanceAntenna(sx126x_context* ctx=sx126x_activeContext);
+void sx126x_fixRxTimeout(sx126x_context* ctx=sx126x_activeContext);
+void sx126x_fixInvertedIq(uint8_t invertIq, sx126x_context* ctx=sx126x_activeContext);
 
 // Utilities
-void sx126x_transfer(uint8_t opCode, uint8_t* data, uint8_t nBytes);
-void sx126x_transfer(uint8_t opCode, uint8_t* data, uint8_t nBytes, uint8_t* address, uint8_t nAddress);
+void sx126x_transfer(uint8_t opCode, uint8_t* data, uint8_t nBytes, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_transfer(uint8_t opCode, uint8_t* data, uint8_t nBytes, uint8_t* address, uint8_t nAddress, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_writeBytes(uint8_t opCode, uint8_t* address, uint8_t nAddress, uint8_t* data, uint8_t nData, sx126x_context* ctx=sx126x_activeContext);
+void sx126x_readBytes(uint8_t opCode, uint8_t* address, uint8_t nAddress, uint8_t* data, uint8_t nData, sx126x_context* ctx=sx126x_activeContext);
+bool sx126x_transferAsync(uint8_t opCode, uint8_t* address, uint8_t nAddress, uint8_t* txBuf, uint8_t* rxBuf, uint8_t nData, void(*callback)(), sx126x_context* ctx=sx126x_activeContext);
 
 #endif
\ No newline at end of file
@@ -1,34 +1,51 @@
 #include <SX127x.h>
 
-void (*SX127x::_onTransmit)();
+SX127x* SX127x::_instances[SX127X_MAX_INSTANCES];
 
-void (*SX127x::_onReceive)();
-
-uint8_t SX127x::_statusIrq = 0xFF;
-
-uint32_t SX127x::_transmitTime = 0;
-
-uint8_t SX127x::_payloadTxRx = 0;
-
-int8_t SX127x::_irqStatic = -1;
-
-int8_t SX127x::_pinToLow = -1;
+void (*const SX127x::_interrupts[SX127X_MAX_INSTANCES])() = {
+    SX127x::_interrupt0, SX127x::_interrupt1, SX127x::_interrupt2, SX127x::_interrupt3
+};
 
 SX127x::SX127x()
 {
-    _spi = &SX127X_SPI;
+    // register object in instance table so interrupt handler can find its own object
+    _slot = 0xFF;
+    for (uint8_t i=0; i<SX127X_MAX_INSTANCES; i++) {
+        if (_instances[i] == NULL) {
+            _instances[i] = this;
+            _slot = i;
+            break;
+        }
+    }
+    _ctx = sx127x_defaultContext;
+    _ctx.shadowValid = 0;
     setPins(SX127X_PIN_NSS, SX127X_PIN_RESET);
 }
 
+SX127x::~SX127x()
+{
+    if (_eventMode) setEventMode(false);
+    if (_slot < SX127X_MAX_INSTANCES) _instances[_slot] = NULL;
+    if (sx127x_activeContext == &_ctx) sx127x_activeContext = &sx127x_defaultContext;
+}
+
 bool SX127x::begin()
 {
+    // interrupt handler not available when all instance slots taken, fail so irq pin not silently ignored
+    // irq pin then cleared so calling begin again use polling operation
+    if (_irq != -1 && _slot >= SX127X_MAX_INSTANCES) {
+        _irq = -1;
+        return false;
+    }
+
     // set pins as input or output
     if (_irq != -1) pinMode(_irq, INPUT);
     if (_txen != -1) pinMode(_txen, OUTPUT);
     if (_rxen != -1) pinMode(_rxen, OUTPUT);
 
     // begin spi and perform device reset
-    sx127x_begin();
+    sx127x_begin(&_ctx);
+    sx127x_onAsyncIdle(_asyncIdle);
     if (!SX127x::reset()) return false;
 
     // set modem to LoRa
@@ -48,63 +65,60 @@ bool SX127x::begin(int8_t nss, int8_t reset, int8_t irq, int8_t txen, int8_t rxe
 void SX127x::end()
 {
     sleep();
-    _spi->end();
+    _ctx.spi->end();
 }
 
 bool SX127x::reset()
 {
-    sx127x_reset(_reset);
+    sx127x_reset(_reset, &_ctx);
     // wait until device connected, return false when device too long to respond
     uint32_t t = millis();
     uint8_t version = 0x00;
     while (version != 0x12 && version != 0x22) {
-        version = sx127x_readRegister(SX127X_REG_VERSION);
+        version = sx127x_readRegister(SX127X_REG_VERSION, &_ctx);
         if (millis() - t > 1000) return false;
     }
+    _version = version;
     return true;
 }
 
 void SX127x::sleep()
 {
     // put device in sleep mode
-    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | SX127X_MODE_SLEEP);
+    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | SX127X_MODE_SLEEP, &_ctx);
 }
 
 void SX127x::wake()
 {
     // wake device by put in standby mode
-    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | SX127X_MODE_STDBY);
+    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | SX127X_MODE_STDBY, &_ctx);
 }
 
 void SX127x::standby()
 {
-    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | SX127X_MODE_STDBY);
+    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | SX127X_MODE_STDBY, &_ctx);
 }
 
 void SX127x::setActive()
 {
-    // override spi, nss, and busy static property in SX127x driver with object property
-    sx127x_setSPI(*_spi, 0);
-    sx127x_setPins(_nss);
+    // driver functions called without context use this object context so they share its register shadow
+    sx127x_activeContext = &_ctx;
 }
 
 void SX127x::setSPI(SPIClass &SpiObject, uint32_t frequency)
 {
-    sx127x_setSPI(SpiObject, frequency);
-
-    _spi = &SpiObject;
+    sx127x_setSPI(SpiObject, frequency, &_ctx);
 }
 
 void SX127x::setPins(int8_t nss, int8_t reset, int8_t irq, int8_t txen, int8_t rxen)
 {
-    sx127x_setPins(nss);
+    sx127x_setPins(nss, &_ctx);
 
-    _nss = nss;
     _reset = reset;
     _irq = irq;
     _txen = txen;
     _rxen = rxen;
-    _irqStatic = digitalPinToInterrupt(_irq);
+    _irqNum = digitalPinToInterrupt(_irq);
 }
 
 void SX127x::setCurrentProtection(uint8_t current)
@@ -117,13 +131,13 @@ void SX127x::setCurrentProtection(uint8_t current)
         ocpTrim = (current + 30) / 10;
     }
     // set over current protection config
-    sx127x_writeRegister(SX127X_REG_OCP, 0x20 | ocpTrim);
+    sx127x_writeRegister(SX127X_REG_OCP, 0x20 | ocpTrim, &_ctx);
 }
 
 void SX127x::setOscillator(uint8_t option)
 {
     uint8_t cfg = option == SX127X_OSC_TCXO ? SX127X_OSC_TCXO : SX127X_OSC_CRYSTAL;
-    sx127x_writeRegister(SX127X_REG_TCXO, cfg);
+    sx127x_writeRegister(SX127X_REG_TCXO, cfg, &_ctx);
 }
 
 void SX127x::setModem(uint8_t modem)
@@ -132,17 +146,46 @@ void SX127x::setModem(uint8_t modem)
     else if (modem == SX127X_FSK_MODEM) _modem = SX127X_MODULATION_FSK;
     else _modem = SX127X_MODULATION_OOK;
     sleep();
-    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | SX127X_MODE_STDBY);
+    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | SX127X_MODE_STDBY, &_ctx);
 }
 
 void SX127x::setFrequency(uint32_t frequency)
 {
-    _frequency = frequency;
     // calculate frequency
-    uint64_t frf = ((uint64_t) frequency << 19) / 32000000;
-    sx127x_writeRegister(SX127X_REG_FRF_MSB, (uint8_t) (frf >> 16));
-    sx127x_writeRegister(SX127X_REG_FRF_MID, (uint8_t) (frf >> 8));
-    sx127x_writeRegister(SX127X_REG_FRF_LSB, (uint8_t) frf);
+    setChannel(channelWord(frequency));
+}
+
+void SX127x::setChannel(uint32_t channel)
+{
+    // frequency only needed for RSSI offset so multiply instead of divide
+    _frequency = ((uint64_t) channel * SX127X_FRF_XTAL) >> SX127X_FRF_SHIFT;
+    // write all frequency registers in one burst
+    uint8_t frf[3] = {(uint8_t) (channel >> 16), (uint8_t) (channel >> 8), (uint8_t) channel};
+    sx127x_writeBurst(SX127X_REG_FRF_MSB, frf, 3, &_ctx);
+}
+
+void SX127x::setHopTable(const uint32_t* channels, uint8_t count)
+{
+    // channels is array of precomputed channel word, must be kept while used
+    _hopTable = channels;
+    _hopCount = count;
+    _hopIndex = 0;
+}
+
+uint8_t SX127x::hop()
+{
+    // move to next channel in hop table
+    if (_hopCount == 0) return 0;
+    _hopIndex = _hopIndex + 1 < _hopCount ? _hopIndex + 1 : 0;
+    setChannel(_hopTable[_hopIndex]);
+    return _hopIndex;
+}
+
+void SX127x::hop(uint8_t index)
+{
+    if (index >= _hopCount) return;
+    _hopIndex = index;
+    setChannel(_hopTable[_hopIndex]);
 }
 
 void SX127x::setTxPower(uint8_t txPower, uint8_t paPin)
@@ -177,10 +220,10 @@ void SX127x::setTxPower(uint8_t txPower, uint8_t paPin)
             setCurrentProtection(140);  // max current 140 mA
         }
         // enable or disable +20 dBm option on PA_BOOST pin
-        sx127x_writeRegister(SX127X_REG_PA_DAC, paDac);
+        sx127x_writeRegister(SX127X_REG_PA_DAC, paDac, &_ctx);
     }
     // set PA config
-    sx127x_writeRegister(SX127X_REG_PA_CONFIG, paConfig | outputPower);
+    sx127x_writeRegister(SX127X_REG_PA_CONFIG, paConfig | outputPower, &_ctx);
 }
 
 void SX127x::setRxGain(uint8_t boost, uint8_t level)
@@ -191,17 +234,33 @@ void SX127x::setRxGain(uint8_t boost, uint8_t level)
     uint8_t LnaBoostHf = boost ? 0x03 : 0x00;
     uint8_t AgcOn = level == SX127X_RX_GAIN_AUTO ? 0x01 : 0x00;
     // set gain and boost LNA config
-    sx127x_writeRegister(SX127X_REG_LNA, LnaBoostHf | (level << 5));
+    sx127x_writeRegister(SX127X_REG_LNA, LnaBoostHf | (level << 5), &_ctx);
     // enable or disable AGC
-    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_3, AgcOn, 2, 1);
+    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_3, AgcOn, 2, 1, &_ctx);
 }
 
-void SX127x::setLoRaModulation(uint8_t sf, uint32_t bw, uint8_t cr, bool ldro)
+void SX127x::setLoRaModulation(uint8_t sf, uint32_t bw, uint8_t cr, uint8_t ldro)
 {
-    setSpreadingFactor(sf);
-    setBandwidth(bw);
-    setCodeRate(cr);
-    setLdroEnable(ldro);
+    // valid spreading factor is 6 - 12 and code rate denominator is 5 - 8
+    if (sf < 6) sf = 6;
+    else if (sf > 12) sf = 12;
+    if (cr < 5) cr = 6;
+    else if (cr > 8) cr = 8;
+    _sf = sf;
+    _bw = bw;
+    _cr = cr;
+    // low data rate optimize set as given or from symbol time with auto option
+    _ldro = ldro == SX127X_LDRO_AUTO ? lora_symbolTime(sf, bw) > 16000 : ldro;
+    _setDetection(sf);
+
+    // compute whole modem config 1 and 2 from shadow cache and write both in one burst only when changed
+    uint8_t config1 = sx127x_readRegister(SX127X_REG_MODEM_CONFIG_1, &_ctx);
+    uint8_t config2 = sx127x_readRegister(SX127X_REG_MODEM_CONFIG_2, &_ctx);
+    uint8_t cfg[2];
+    cfg[0] = (_bwConfig(bw) << 4) | ((cr - 4) << 1) | (config1 & 0x01);
+    cfg[1] = (sf << 4) | (config2 & 0x0F);
+    if (cfg[0] != config1 || cfg[1] != config2) sx127x_writeBurst(SX127X_REG_MODEM_CONFIG_1, cfg, 2, &_ctx);
+    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_3, _ldro ? 0x01 : 0x00, 3, 1, &_ctx);
 }
 
 void SX127x::setLoRaPacket(uint8_t headerType, uint16_t preambleLength, uint8_t payloadLength, bool crcType, bool invertIq)
@@ -219,30 +278,38 @@ void SX127x::setSpreadingFactor(uint8_t sf)
     // valid spreading factor is 6 - 12
     if (sf < 6) sf = 6;
     else if (sf > 12) sf = 12;
-    // set appropriate signal detection optimize and threshold
-    uint8_t optimize = sf == 6 ? 0x05 : 0x03;
-    uint8_t threshold = sf == 6 ? 0x0C : 0x0A;
-    sx127x_writeRegister(SX127X_REG_DETECTION_OPTIMIZE, optimize);
-    sx127x_writeRegister(SX127X_REG_DETECTION_THRESHOLD, threshold);
+    _setDetection(sf);
     // set spreading factor config
-    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_2, sf, 4, 4);
+    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_2, sf, 4, 4, &_ctx);
 }
 
 void SX127x::setBandwidth(uint32_t bw)
 {
     _bw = bw;
-    uint8_t bwCfg;
-    if (bw < 9100) bwCfg = 0;           // 7.8 kHz
-    else if (bw < 13000) bwCfg = 1;     // 10.4 kHz
-    else if (bw < 18200) bwCfg = 2;     // 15.6 kHz
-    else if (bw < 26000) bwCfg = 3;     // 20.8 kHz
-    else if (bw < 36500) bwCfg = 4;     // 31.25 kHz
-    else if (bw < 52100) bwCfg = 5;     // 41.7 kHz
-    else if (bw < 93800) bwCfg = 6;     // 62.5 kHz
-    else if (bw < 187500) bwCfg = 7;    // 125 kHz
-    else if (bw < 375000) bwCfg = 8;    // 250 kHz
-    else bwCfg = 9;                     // 500 kHz
-    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_1, bwCfg, 4, 4);
+    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_1, _bwConfig(bw), 4, 4, &_ctx);
+}
+
+uint8_t SX127x::_bwConfig(uint32_t bw)
+{
+    if (bw < 9100) return 0;            // 7.8 kHz
+    else if (bw < 13000) return 1;      // 10.4 kHz
+    else if (bw < 18200) return 2;      // 15.6 kHz
+    else if (bw < 26000) return 3;      // 20.8 kHz
+    else if (bw < 36500) return 4;      // 31.25 kHz
+    else if (bw < 52100) return 5;      // 41.7 kHz
+    else if (bw < 93800) return 6;      // 62.5 kHz
+    else if (bw < 187500) return 7;     // 125 kHz
+    else if (bw < 375000) return 8;     // 250 kHz
+    return 9;                           // 500 kHz
+}
+
+void SX127x::_setDetection(uint8_t sf)
+{
+    // set appropriate signal detection optimize and threshold, write skipped by shadow cache when unchanged
+    uint8_t optimize = sf == 6 ? 0x05 : 0x03;
+    uint8_t threshold = sf == 6 ? 0x0C : 0x0A;
+    sx127x_writeRegister(SX127X_REG_DETECTION_OPTIMIZE, optimize, &_ctx);
+    sx127x_writeRegister(SX127X_REG_DETECTION_THRESHOLD, threshold, &_ctx);
 }
 
 void SX127x::setCodeRate(uint8_t cr)
@@ -250,48 +317,52 @@ void SX127x::setCodeRate(uint8_t cr)
     // valid code rate denominator is 5 - 8
     if (cr < 5) cr = 6;
     else if (cr > 8) cr = 8;
+    _cr = cr;
     uint8_t crCfg = cr - 4;
-    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_1, crCfg, 1, 3);
+    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_1, crCfg, 1, 3, &_ctx);
 }
 
 void SX127x::setLdroEnable(bool ldro)
 {
+    _ldro = ldro;
     uint8_t ldroCfg = ldro ? 0x01 : 0x00;
-    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_3, ldroCfg, 3, 1);
+    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_3, ldroCfg, 3, 1, &_ctx);
 }
 
 void SX127x::setHeaderType(uint8_t headerType)
 {
     _headerType = headerType;
     uint8_t headerTypeCfg = headerType == SX127X_HEADER_IMPLICIT ? SX127X_HEADER_IMPLICIT : SX127X_HEADER_EXPLICIT;
-    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_1, headerTypeCfg, 0, 1);
+    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_1, headerTypeCfg, 0, 1, &_ctx);
 }
 
 void SX127x::setPreambleLength(uint16_t preambleLength)
 {
-    sx127x_writeRegister(SX127X_REG_PREAMBLE_MSB, (uint8_t) (preambleLength >> 8));
-    sx127x_writeRegister(SX127X_REG_PREAMBLE_LSB, (uint8_t) preambleLength);
+    _preambleLength = preambleLength;
+    sx127x_writeRegister(SX127X_REG_PREAMBLE_MSB, (uint8_t) (preambleLength >> 8), &_ctx);
+    sx127x_writeRegister(SX127X_REG_PREAMBLE_LSB, (uint8_t) preambleLength, &_ctx);
 }
 
 void SX127x::setPayloadLength(uint8_t payloadLength)
 {
     _payloadLength = payloadLength;
-    sx127x_writeRegister(SX127X_REG_PAYLOAD_LENGTH, payloadLength);
+    sx127x_writeRegister(SX127X_REG_PAYLOAD_LENGTH, payloadLength, &_ctx);
 }
 
 void SX127x::setCrcEnable(bool crcType)
 {
+    _crcType = crcType;
     uint8_t crcTypeCfg = crcType ? 0x01 : 0x00;
-    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_2, crcTypeCfg, 2, 1);
+    sx127x_writeBits(SX127X_REG_MODEM_CONFIG_2, crcTypeCfg, 2, 1, &_ctx);
 }
 
 void SX127x::setInvertIq(bool invertIq)
 {
     uint8_t invertIqCfg1 = invertIq ? 0x01 : 0x00;
     uint8_t invertIqCfg2 = invertIq ? 0x19 : 0x1D;
-    sx127x_writeBits(SX127X_REG_INVERTIQ, invertIqCfg1, 0, 1);
-    sx127x_writeBits(SX127X_REG_INVERTIQ, invertIqCfg1, 6, 1);
-    sx127x_writeRegister(SX127X_REG_INVERTIQ2, invertIqCfg2);
+    sx127x_writeBits(SX127X_REG_INVERTIQ, invertIqCfg1, 0, 1, &_ctx);
+    sx127x_writeBits(SX127X_REG_INVERTIQ, invertIqCfg1, 6, 1, &_ctx);
+    sx127x_writeRegister(SX127X_REG_INVERTIQ2, invertIqCfg2, &_ctx);
 }
 
 void SX127x::setSyncWord(uint16_t syncWord)
@@ -300,14 +371,15 @@ void SX127x::setSyncWord(uint16_t syncWord)
     if (syncWord > 0xFF) {
         sw = ((syncWord >> 8) & 0xF0) | (syncWord & 0x0F);
     }
-    sx127x_writeRegister(SX127X_REG_SYNC_WORD, sw);
+    sx127x_writeRegister(SX127X_REG_SYNC_WORD, sw, &_ctx);
 }
 
 void SX127x::beginPacket()
 {
     // reset TX buffer base address, FIFO address pointer and payload length
-    sx127x_writeRegister(SX127X_REG_FIFO_TX_BASE_ADDR, sx127x_readRegister(SX127X_REG_FIFO_ADDR_PTR));
+    sx127x_writeRegister(SX127X_REG_FIFO_TX_BASE_ADDR, sx127x_readRegister(SX127X_REG_FIFO_ADDR_PTR, &_ctx), &_ctx);
     _payloadTxRx = 0;
+    _stageLen = 0;
 
     // set txen pin to high and rxen pin to low
     if ((_rxen != -1) && (_txen != -1)){
@@ -320,46 +392,116 @@ void SX127x::beginPacket()
 bool SX127x::endPacket(uint32_t timeout)
 {
     // skip to enter TX mode when previous TX operation incomplete
-    if (sx127x_readRegister(SX127X_REG_OP_MODE) & 0x07 == SX127X_MODE_TX) return false;
+    if (sx127x_readRegister(SX127X_REG_OP_MODE, &_ctx) & 0x07 == SX127X_MODE_TX) return false;
+    // skip to enter TX mode when duty cycle limit of sub-band reached
+    if (_dutyCycle) {
+        if (!_dutyCycle->allowed(_frequency)) return false;
+    }
+    // skip to enter TX mode when channel still busy after listen before talk attempts, not run inside interrupt handler
+    if (_lbtAttempts && !_inInterrupt) {
+        if (!_channelClear()) return false;
+    }
+    // write staged packet to radio in single transfer
+    if (_stageLen) _stageFlush();
 
     // clear IRQ flag from last TX or RX operation
-    sx127x_writeRegister(SX127X_REG_IRQ_FLAGS, 0xFF);
+    sx127x_writeRegister(SX127X_REG_IRQ_FLAGS, 0xFF, &_ctx);
 
     // set packet payload length
-    sx127x_writeRegister(SX127X_REG_PAYLOAD_LENGTH, _payloadTxRx);
+    sx127x_writeRegister(SX127X_REG_PAYLOAD_LENGTH, _payloadTxRx, &_ctx);
 
     // set status to TX wait
     _statusWait = SX127X_STATUS_TX_WAIT;
     _statusIrq = 0x00;
 
     // set device to transmit mode
-    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | SX127X_MODE_TX);
+    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | SX127X_MODE_TX, &_ctx);
     _transmitTime = millis();
+    _waitStart = micros();
+    uint32_t airTime = timeOnAir(_payloadTxRx);
+    if (_dutyCycle) _dutyCycle->record(_frequency, airTime);
+    // polling wait start checking IRQ status shortly before expected transmit finish
+    _waitExpected = _modem == SX127X_LONG_RANGE_MODE ? airTime - (airTime >> 4) : 0;
 
     // set TX done interrupt on DIO0 and attach TX interrupt handler
     if (_irq != -1) {
-        sx127x_writeRegister(SX127X_REG_DIO_MAPPING_1, SX127X_DIO0_TX_DONE);
-        attachInterrupt(_irqStatic, SX127x::_interruptTx, RISING);
+        sx127x_writeRegister(SX127X_REG_DIO_MAPPING_1, SX127X_DIO0_TX_DONE, &_ctx);
+        if (!_eventMode) attachInterrupt(_irqNum, _interrupts[_slot], RISING);
     }
     return true;
 }
 
+void SX127x::setListenBeforeTalk(uint8_t attempts, uint32_t backoff)
+{
+    // check channel activity before transmit, retry after random backoff up to backoff millisecond, 0 attempts disable
+    _lbtAttempts = attempts;
+    _lbtBackoff = backoff ? backoff : 1;
+}
+
+void SX127x::setDutyCycle(LoRaDutyCycle* dutyCycle)
+{
+    // track airtime of every transmit and refuse transmit when sub-band limit reached
+    _dutyCycle = dutyCycle;
+}
+
+bool SX127x::queuePacket(uint8_t* data, uint8_t length)
+{
+    // FIFO only can be filled in standby mode, so data must be kept until transmitted
+    if (_txQueueCount >= SX127X_TX_QUEUE_SIZE) return false;
+
+    // add packet to queue and start transmit when no queued packet transmitting
+    noInterrupts();
+    uint8_t head = (_txQueueTail + _txQueueCount) % SX127X_TX_QUEUE_SIZE;
+    _txQueueData[head] = data;
+    _txQueueLength[head] = length;
+    _txQueueCount++;
+    bool start = !_txQueueActive;
+    interrupts();
+    if (start) _txQueueStart();
+    return true;
+}
+
+uint8_t SX127x::txQueued()
+{
+    // number of queued packets including packet being transmitted
+    return _txQueueCount;
+}
+
+uint16_t SX127x::txDropped()
+{
+    // number of queued packets dropped because transmit refused by duty cycle limit or busy channel
+    return _txDropped;
+}
+
 void SX127x::write(uint8_t data)
 {
     // write single byte of package to be transmitted
-    write(&data, 1);
+    if (_stageWrite(&data, 1)) return;
+    sx127x_writeRegister(SX127X_REG_FIFO, data, &_ctx);
+    _payloadTxRx++;
 }
 
 void SX127x::write(uint8_t* data, uint8_t length)
 {
-    // write multiple bytes of package to be transmitted in FIFO buffer
-    for (uint8_t i = 0; i < length; i++) {
-        sx127x_writeRegister(SX127X_REG_FIFO, data[i]);
-    }
+    // write multiple bytes of package to be transmitted in FIFO buffer, data can be reused when return
+    if (_stageWrite(data, length)) return;
+    sx127x_writeBurst(SX127X_REG_FIFO, data, length, &_ctx);
     // increasing payload length
     _payloadTxRx += length;
 }
 
+void SX127x::writeAsync(uint8_t* data, uint8_t length, void(*callback)())
+{
+    // write multiple bytes of package with asynchronous transfer routine and return before transfer done
+    // data must stay valid and unchanged until callback called, callback called immediately when data copied to staging buffer
+    if (_stageWrite(data, length)) {
+        if (callback) callback();
+        return;
+    }
+    sx127x_writeBurstAsync(SX127X_REG_FIFO, data, length, callback, &_ctx);
+    _payloadTxRx += length;
+}
+
 void SX127x::write(char* data, uint8_t length)
 {
     // write multiple bytes of package to be transmitted for char type
@@ -367,14 +509,41 @@ void SX127x::write(char* data, uint8_t length)
     write(data_, length);
 }
 
+void SX127x::writev(const LoRaSegment* segments, uint8_t count)
+{
+    // write header and payload from separate buffers in single transfer without copying, copied when staging buffer used
+    if (_stage) {
+        for (uint8_t i=0; i<count; i++) {
+            // segment larger than staging buffer written directly
+            if (_stageWrite(segments[i].data, segments[i].length)) continue;
+            sx127x_writeBurstv(SX127X_REG_FIFO, &segments[i], 1, &_ctx);
+            _payloadTxRx += segments[i].length;
+        }
+        return;
+    }
+    uint8_t length = 0;
+    for (uint8_t i=0; i<count; i++) length += segments[i].length;
+    sx127x_writeBurstv(SX127X_REG_FIFO, segments, count, &_ctx);
+    _payloadTxRx += length;
+}
+
+void SX127x::setPacketBuffer(uint8_t* buffer, uint8_t size)
+{
+    // stage written packet in RAM and send to radio in single transfer, received packet read at once to this buffer
+    _stage = size ? buffer : NULL;
+    _stageSize = size;
+    _stageLen = 0;
+    _stagePos = 0;
+}
+
 bool SX127x::request(uint32_t timeout)
 {
     // skip to enter RX mode when previous RX operation incomplete
-    uint8_t rxMode = sx127x_readRegister(SX127X_REG_OP_MODE) & 0x07;
+    uint8_t rxMode = sx127x_readRegister(SX127X_REG_OP_MODE, &_ctx) & 0x07;
     if (rxMode == SX127X_MODE_RX_SINGLE || rxMode == SX127X_MODE_RX_CONTINUOUS) return false;
 
     // clear IRQ flag from last TX or RX operation
-    sx127x_writeRegister(SX127X_REG_IRQ_FLAGS, 0xFF);
+    sx127x_writeRegister(SX127X_REG_IRQ_FLAGS, 0xFF, &_ctx);
 
     // set txen pin to low and rxen pin to high
     if ((_rxen != -1) && (_txen != -1)){
@@ -385,6 +554,7 @@ bool SX127x::request(uint32_t timeout)
 
     // set status to RX wait
     _statusWait = SX127X_STATUS_RX_WAIT;
+    _waitExpected = 0;
     _statusIrq = 0x00;
     // select RX mode to RX continuous mode for RX single and continuos operation
     rxMode = SX127X_MODE_RX_CONTINUOUS;
@@ -396,21 +566,39 @@ bool SX127x::request(uint32_t timeout)
         // calculate and set symbol timeout
         uint16_t symbTimeout = (timeout * _bw / 1000) >> _sf; // devided by 1000, ms to s
         symbTimeout = symbTimeout < 0x03FF ? symbTimeout : 0x03FF;
-        sx127x_writeBits(SX127X_REG_MODEM_CONFIG_2, (symbTimeout >> 8) & 0x03, 0, 2);
-        sx127x_writeRegister(SX127X_REG_SYMB_TIMEOUT, symbTimeout);
+        sx127x_writeBits(SX127X_REG_MODEM_CONFIG_2, (symbTimeout >> 8) & 0x03, 0, 2, &_ctx);
+        sx127x_writeRegister(SX127X_REG_SYMB_TIMEOUT, symbTimeout, &_ctx);
     }
 
     // set device to receive mode
-    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | rxMode);
+    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | rxMode, &_ctx);
 
     // set RX done interrupt on DIO0 and attach RX interrupt handler
     if (_irq != -1) {
-        sx127x_writeRegister(SX127X_REG_DIO_MAPPING_1, SX127X_DIO0_RX_DONE);
-        if (timeout == SX127X_RX_CONTINUOUS) {
-            attachInterrupt(_irqStatic, SX127x::_interruptRxContinuous, RISING);
-        } else {
-            attachInterrupt(_irqStatic, SX127x::_interruptRx, RISING);
-        }
+        sx127x_writeRegister(SX127X_REG_DIO_MAPPING_1, SX127X_DIO0_RX_DONE, &_ctx);
+        if (!_eventMode) attachInterrupt(_irqNum, _interrupts[_slot], RISING);
+    }
+    return true;
+}
+
+bool SX127x::cad()
+{
+    // skip to start CAD when previous TX, RX, or CAD operation incomplete
+    uint8_t mode = sx127x_readRegister(SX127X_REG_OP_MODE, &_ctx) & 0x07;
+    if (mode == SX127X_MODE_TX || mode == SX127X_MODE_RX_CONTINUOUS || mode == SX127X_MODE_RX_SINGLE || mode == SX127X_MODE_CAD) return false;
+
+    // clear IRQ flag from last TX or RX operation
+    sx127x_writeRegister(SX127X_REG_IRQ_FLAGS, 0xFF, &_ctx);
+
+    // set status to CAD wait and start channel activity detection
+    _statusWait = SX127X_STATUS_CAD_WAIT;
+    _statusIrq = 0x00;
+    _cadStart();
+
+    // set CAD done interrupt on DIO0 and attach CAD interrupt handler
+    if (_irq != -1) {
+        sx127x_writeRegister(SX127X_REG_DIO_MAPPING_1, SX127X_DIO0_CAD_DONE, &_ctx);
+        if (!_eventMode) attachInterrupt(_irqNum, _interrupts[_slot], RISING);
     }
     return true;
 }
@@ -431,6 +619,16 @@ uint8_t SX127x::read()
 
 uint8_t SX127x::read(uint8_t* data, uint8_t length)
 {
+    // copy from staging buffer, remaining payload loaded in single transfer when staging buffer empty
+    if (_stage) {
+        uint8_t n = 0;
+        while (n < length && _payloadTxRx) {
+            if (_stagePos >= _stageLen) _stageLoad();
+            data[n++] = _stage[_stagePos++];
+            _payloadTxRx--;
+        }
+        return n;
+    }
     // calculate actual read length and remaining payload length
     if (_payloadTxRx > length) {
         _payloadTxRx -= length;
@@ -440,9 +638,7 @@ uint8_t SX127x::read(uint8_t* data, uint8_t length)
         _payloadTxRx = 0;
     }
     // read multiple bytes of received package in FIFO buffer
-    for (uint8_t i = 0; i < length; i++) {
-        data[i] = sx127x_readRegister(SX127X_REG_FIFO);
-    }
+    sx127x_readBurst(SX127X_REG_FIFO, data, length, &_ctx);
     return length;
 }
 
@@ -455,6 +651,19 @@ uint8_t SX127x::read(char* data, uint8_t length)
 
 void SX127x::purge(uint8_t length)
 {
+    // drop bytes in staging buffer first
+    if (_stage && _stagePos < _stageLen) {
+        uint8_t staged = _stageLen - _stagePos;
+        if (length && length < staged) {
+            _stagePos += length;
+            _payloadTxRx -= length;
+            return;
+        }
+        _stageLen = 0;
+        _payloadTxRx -= staged;
+        if (length == staged) return;
+        if (length) length -= staged;
+    }
     // subtract or reset received payload length
     _payloadTxRx = (_payloadTxRx > length) && length ? _payloadTxRx - length : 0;
 }
@@ -468,12 +677,33 @@ bool SX127x::wait(uint32_t timeout)
     uint8_t irqFlag = 0x00;
     uint8_t irqFlagMask = _statusWait == SX127X_STATUS_TX_WAIT 
         ? SX127X_IRQ_TX_DONE 
+        : _statusWait == SX127X_STATUS_CAD_WAIT
+        ? SX127X_IRQ_CAD_DONE
         : SX127X_IRQ_RX_DONE | SX127X_IRQ_RX_TIMEOUT | SX127X_IRQ_CRC_ERR
     ;
     uint32_t t = millis();
+    // first poll after expected transmit time then poll with increasing interval
+    uint32_t elapsed = micros() - _waitStart;
+    uint32_t interval = elapsed < _waitExpected ? _waitExpected - elapsed : 0;
+    uint32_t backoff = SX127X_POLL_INTERVAL_MIN;
+    uint32_t tPoll = micros();
+    _pollCount = 0;
     while (!(irqFlag & irqFlagMask) && _statusIrq == 0x00) {
-        // only check IRQ status register for non interrupt operation
-        if (_irq == -1) irqFlag = sx127x_readRegister(SX127X_REG_IRQ_FLAGS);
+        // only check IRQ status register for non interrupt operation, handle pending interrupt in event mode
+        if (_irq == -1) {
+            uint32_t tNow = micros();
+            if (tNow - tPoll >= interval) {
+                irqFlag = sx127x_readRegister(SX127X_REG_IRQ_FLAGS, &_ctx);
+                _pollCount++;
+                tPoll = tNow;
+                interval = backoff;
+                if (backoff < SX127X_POLL_INTERVAL_MAX) backoff <<= 1;
+            } else if (interval - (tNow - tPoll) > 1000) {
+                // sleep instead of spinning when next poll more than 1 ms away
+                delay(1);
+            }
+        }
+        else if (_eventMode) process();
         // return when timeout reached
         if (millis() - t > timeout && timeout != 0) return false;
         yield();
@@ -492,24 +722,65 @@ bool SX127x::wait(uint32_t timeout)
         // terminate receive mode by setting mode to standby
         standby();
         // set pointer to RX buffer base address and get packet payload length
-        sx127x_writeRegister(SX127X_REG_FIFO_ADDR_PTR, sx127x_readRegister(SX127X_REG_FIFO_RX_CURRENT_ADDR));
-        _payloadTxRx = sx127x_readRegister(SX127X_REG_RX_NB_BYTES);
+        sx127x_writeRegister(SX127X_REG_FIFO_ADDR_PTR, sx127x_readRegister(SX127X_REG_FIFO_RX_CURRENT_ADDR, &_ctx), &_ctx);
+        _payloadTxRx = sx127x_readRegister(SX127X_REG_RX_NB_BYTES, &_ctx);
+        _rxTime = micros();
+        _stageLen = 0;
         // set back rxen pin to low
         if (_rxen != -1) digitalWrite(_rxen, LOW);
+        if (_packetHandler && (irqFlag & SX127X_IRQ_RX_DONE)) _handlePacket(irqFlag);
 
     } else if (_statusWait == SX127X_STATUS_RX_CONTINUOUS) {
         // set pointer to RX buffer base address and get packet payload length
-        sx127x_writeRegister(SX127X_REG_FIFO_ADDR_PTR, sx127x_readRegister(SX127X_REG_FIFO_RX_CURRENT_ADDR));
-        _payloadTxRx = sx127x_readRegister(SX127X_REG_RX_NB_BYTES);
+        sx127x_writeRegister(SX127X_REG_FIFO_ADDR_PTR, sx127x_readRegister(SX127X_REG_FIFO_RX_CURRENT_ADDR, &_ctx), &_ctx);
+        _payloadTxRx = sx127x_readRegister(SX127X_REG_RX_NB_BYTES, &_ctx);
+        _rxTime = micros();
+        _stageLen = 0;
         // clear IRQ flag
-        sx127x_writeRegister(SX127X_REG_IRQ_FLAGS, 0xFF);
+        sx127x_writeRegister(SX127X_REG_IRQ_FLAGS, 0xFF, &_ctx);
+        if (_pool && (irqFlag & SX127X_IRQ_RX_DONE)) _storePacket(irqFlag);
+        if (_packetHandler && (irqFlag & SX127X_IRQ_RX_DONE)) _handlePacket(irqFlag);
+
+    } else if (_statusWait == SX127X_STATUS_CAD_WAIT) {
+        // set back rxen pin to low
+        if (_rxen != -1) digitalWrite(_rxen, LOW);
     }
 
-    // store IRQ status
+    // store IRQ status and start next queued packet after transmit done
     _statusIrq = irqFlag;
+    if (_statusWait == SX127X_STATUS_TX_WAIT && _txQueueActive) _txQueueDone();
     return true;
 }
 
+void SX127x::setEventMode(bool enable)
+{
+    // keep interrupt attached and defer SPI transfer and callback of interrupt handler to process()
+    if (_irq != -1) {
+        if (enable && !_eventMode) attachInterrupt(_irqNum, _interrupts[_slot], RISING);
+        else if (!enable && _eventMode) detachInterrupt(_irqNum);
+    }
+    _eventMode = enable;
+    _eventPending = false;
+}
+
+bool SX127x::process()
+{
+    // run interrupt handler of pending event outside interrupt context
+    if (!_eventPending) return false;
+    _eventPending = false;
+    if (_statusWait == SX127X_STATUS_TX_WAIT) _interruptTx();
+    else if (_statusWait == SX127X_STATUS_CAD_WAIT) _interruptCad();
+    else if (_statusWait == SX127X_STATUS_RX_CONTINUOUS) _interruptRxContinuous();
+    else _interruptRx();
+    return true;
+}
+
+uint32_t SX127x::pollCount()
+{
+    // number of IRQ status reads of last wait in polling operation
+    return _pollCount;
+}
+
 uint8_t SX127x::status()
 {
     // set back status IRQ for RX continuous operation
@@ -521,6 +792,8 @@ uint8_t SX127x::status()
     // get status for transmit and receive operation based on status IRQ
     if (statusIrq & SX127X_IRQ_RX_TIMEOUT) return SX127X_STATUS_RX_TIMEOUT;
     else if (statusIrq & SX127X_IRQ_CRC_ERR) return SX127X_STATUS_CRC_ERR;
+    else if (statusIrq & SX127X_IRQ_CAD_DETECTED) return SX127X_STATUS_CAD_DETECTED;
+    else if (statusIrq & SX127X_IRQ_CAD_DONE) return SX127X_STATUS_CAD_DONE;
     else if (statusIrq & SX127X_IRQ_TX_DONE) return SX127X_STATUS_TX_DONE;
     else if (statusIrq & SX127X_IRQ_RX_DONE) return SX127X_STATUS_RX_DONE;
 
@@ -534,6 +807,13 @@ uint32_t SX127x::transmitTime()
     return _transmitTime;
 }
 
+uint32_t SX127x::timeOnAir(uint8_t length)
+{
+    // calculate time on air in microsecond of packet with current modulation and packet parameters
+    uint8_t sf = _sf < 6 ? 6 : (_sf > 12 ? 12 : _sf);
+    return lora_timeOnAir(sf, _bw, _cr, _ldro, _headerType == SX127X_HEADER_IMPLICIT, _preambleLength, _crcType, length);
+}
+
 float SX127x::dataRate()
 {
     // get data rate last transmitted package in kbps
@@ -543,32 +823,49 @@ float SX127x::dataRate()
 int16_t SX127x::packetRssi()
 {
     // get relative signal strength index (RSSI) of last incoming package
-    int16_t offset = _frequency < SX127X_BAND_THRESHOLD ? SX127X_RSSI_OFFSET_LF : SX127X_RSSI_OFFSET_HF;
-    if (sx127x_readRegister(SX127X_REG_VERSION) == 0x22) {
-        offset = SX1272_RSSI_OFFSET;
-    }
-    return (int16_t) sx127x_readRegister(SX127X_REG_PKT_RSSI_VALUE) - offset;
+    return (int16_t) sx127x_readRegister(SX127X_REG_PKT_RSSI_VALUE, &_ctx) - _rssiOffset();
 }
 
 int16_t SX127x::rssi()
 {
-    int16_t offset = _frequency < SX127X_BAND_THRESHOLD ? SX127X_RSSI_OFFSET_LF : SX127X_RSSI_OFFSET_HF;
-    if (sx127x_readRegister(SX127X_REG_VERSION) == 0x22) {
-        offset = SX1272_RSSI_OFFSET;
-    }
-    return (int16_t) sx127x_readRegister(SX127X_REG_RSSI_VALUE) - offset;
+    return (int16_t) sx127x_readRegister(SX127X_REG_RSSI_VALUE, &_ctx) - _rssiOffset();
 }
 
 float SX127x::snr()
 {
     // get signal to noise ratio (SNR) of last incoming package
-    return (int8_t) sx127x_readRegister(SX127X_REG_PKT_SNR_VALUE) / 4.0;
+    return (int8_t) sx127x_readRegister(SX127X_REG_PKT_SNR_VALUE, &_ctx) / 4.0;
+}
+
+int16_t SX127x::_rssiOffset()
+{
+    if (_version == 0x22) return SX1272_RSSI_OFFSET;
+    return _frequency < SX127X_BAND_THRESHOLD ? SX127X_RSSI_OFFSET_LF : SX127X_RSSI_OFFSET_HF;
+}
+
+void SX127x::packetInfo(LoRaPacketInfo* info)
+{
+    // get all status of last incoming package with single burst read from RX bytes register to frequency error registers
+    uint8_t reg[SX127X_REG_FREQ_ERROR_LSB - SX127X_REG_RX_NB_BYTES + 1];
+    sx127x_readBurst(SX127X_REG_RX_NB_BYTES, reg, sizeof(reg), &_ctx);
+    info->length = reg[0];
+    info->snr = (int8_t) reg[SX127X_REG_PKT_SNR_VALUE - SX127X_REG_RX_NB_BYTES] / 4.0;
+    info->rssi = (int16_t) reg[SX127X_REG_PKT_RSSI_VALUE - SX127X_REG_RX_NB_BYTES] - _rssiOffset();
+    // signal strength below noise floor corrected with negative SNR
+    info->signalRssi = info->snr < 0 ? info->rssi + info->snr : info->rssi;
+    // 20-bit signed frequency error, scaled by 2^24 / 32 MHz and bandwidth / 500 kHz
+    uint8_t* ferr = &reg[SX127X_REG_FREQ_ERROR_MSB - SX127X_REG_RX_NB_BYTES];
+    int32_t freqError = ((uint32_t) (ferr[0] & 0x0F) << 16) | ((uint16_t) ferr[1] << 8) | ferr[2];
+    if (freqError & 0x80000) freqError -= 0x100000;
+    info->freqError = (float) freqError * 0.524288 * _bw / 500000;
+    info->irqStatus = _statusIrq;
+    info->timestamp = _rxTime;
 }
 
 uint32_t SX127x::random()
 {
     // generate random number from register and previous random number
-    uint32_t n = sx127x_readRegister(SX127X_REG_RSSI_WIDEBAND);
+    uint32_t n = sx127x_readRegister(SX127X_REG_RSSI_WIDEBAND, &_ctx);
     uint32_t number = (n << 24) | ((~n & 0xFF) << 16) | (n << 8) | (~n & 0xFF);
     n = _random;
     number = number ^ ((~n << 16) | n);
@@ -579,6 +876,162 @@ uint32_t SX127x::random()
     return number;
 }
 
+void SX127x::_interrupt0()
+{
+    _instances[0]->_interrupt();
+}
+
+void SX127x::_interrupt1()
+{
+    _instances[1]->_interrupt();
+}
+
+void SX127x::_interrupt2()
+{
+    _instances[2]->_interrupt();
+}
+
+void SX127x::_interrupt3()
+{
+    _instances[3]->_interrupt();
+}
+
+void SX127x::_interrupt()
+{
+    // in event mode or while asynchronous transfer use SPI bus only flag interrupt,
+    // handler called later by process() or by _asyncIdle() when transfer done
+    _irqTime = micros();
+    _eventPending = true;
+    if (_eventMode || sx127x_asyncBusy()) return;
+    _dispatch();
+}
+
+void SX127x::_dispatch()
+{
+    // run handler of flagged interrupt in interrupt context
+    _inInterrupt = true;
+    process();
+    _inInterrupt = false;
+}
+
+void SX127x::_asyncIdle()
+{
+    // run interrupt handler deferred while asynchronous transfer used SPI bus
+    for (uint8_t i=0; i<SX127X_MAX_INSTANCES; i++) {
+        SX127x* radio = _instances[i];
+        if (radio && radio->_eventPending && !radio->_eventMode) radio->_dispatch();
+    }
+}
+
+bool SX127x::_stageWrite(const uint8_t* data, uint8_t length)
+{
+    // copy to staging buffer, flush staged bytes first when buffer full and write directly when data larger than buffer
+    if (_stage == NULL) return false;
+    if (_stageLen + length > _stageSize) {
+        _stageFlush();
+        if (length > _stageSize) return false;
+    }
+    memcpy(_stage + _stageLen, data, length);
+    _stageLen += length;
+    _payloadTxRx += length;
+    return true;
+}
+
+void SX127x::_stageFlush()
+{
+    sx127x_writeBurst(SX127X_REG_FIFO, _stage, _stageLen, &_ctx);
+    _stageLen = 0;
+}
+
+void SX127x::_stageLoad()
+{
+    // read remaining received payload or as much as staging buffer size from FIFO
+    uint8_t length = _payloadTxRx < _stageSize ? _payloadTxRx : _stageSize;
+    sx127x_readBurst(SX127X_REG_FIFO, _stage, length, &_ctx);
+    _stageLen = length;
+    _stagePos = 0;
+}
+
+void SX127x::_txQueueStart()
+{
+    // device back in standby after transmit done so next packet can be written to FIFO, drop packet when transmit refused
+    while (_txQueueCount) {
+        beginPacket();
+        sx127x_writeBurst(SX127X_REG_FIFO, _txQueueData[_txQueueTail], _txQueueLength[_txQueueTail], &_ctx);
+        _payloadTxRx = _txQueueLength[_txQueueTail];
+        _txQueueActive = endPacket();
+        if (_txQueueActive) return;
+        _txDropped++;
+        _txQueueRemove();
+    }
+}
+
+void SX127x::_txQueueDone()
+{
+    // remove transmitted packet then start next queued packet
+    _txQueueActive = false;
+    _txQueueRemove();
+    if (_txQueueCount) _txQueueStart();
+}
+
+void SX127x::_txQueueRemove()
+{
+    _txQueueTail = (_txQueueTail + 1) % SX127X_TX_QUEUE_SIZE;
+    _txQueueCount--;
+}
+
+void SX127x::_cadStart()
+{
+    // set txen pin to low and rxen pin to high
+    if ((_rxen != -1) && (_txen != -1)){
+        digitalWrite(_rxen, HIGH);
+        digitalWrite(_txen, LOW);
+        _pinToLow = _rxen;
+    }
+
+    // device go back to standby after CAD done
+    sx127x_writeRegister(SX127X_REG_OP_MODE, _modem | SX127X_MODE_CAD, &_ctx);
+    _waitStart = micros();
+    _waitExpected = lora_symbolTime(_sf, _bw);
+}
+
+bool SX127x::_channelClear()
+{
+    // CAD with IRQ flag polling and DIO0 kept on RX done so interrupt handler not called
+    if (_irq != -1) sx127x_writeRegister(SX127X_REG_DIO_MAPPING_1, SX127X_DIO0_RX_DONE, &_ctx);
+    bool clear = false;
+    for (uint8_t i=0; i<_lbtAttempts; i++) {
+        // back off random time before next attempt while channel busy
+        if (i) delay(random() % _lbtBackoff);
+        sx127x_writeRegister(SX127X_REG_IRQ_FLAGS, 0xFF, &_ctx);
+        _cadStart();
+        // give up as busy when CAD not done within twice expected CAD time
+        uint32_t t = millis();
+        uint32_t timeout = _waitExpected / 500 + 10;
+        uint8_t irqFlag = 0x00;
+        while (!(irqFlag & SX127X_IRQ_CAD_DONE)) {
+            if (millis() - t > timeout) break;
+            irqFlag = sx127x_readRegister(SX127X_REG_IRQ_FLAGS, &_ctx);
+        }
+        if (!(irqFlag & SX127X_IRQ_CAD_DONE)) {
+            standby();
+            break;
+        }
+        if (!(irqFlag & SX127X_IRQ_CAD_DETECTED)) {
+            clear = true;
+            break;
+        }
+    }
+
+    // set back txen pin to high and rxen pin to low for following transmit
+    if ((_rxen != -1) && (_txen != -1)){
+        digitalWrite(_rxen, LOW);
+        digitalWrite(_txen, HIGH);
+        _pinToLow = _txen;
+    }
+    return clear;
+}
+
 void SX127x::_interruptTx()
 {
     // calculate transmit time
@@ -589,31 +1042,37 @@ void SX127x::_interruptTx()
 
     // set back txen pin to low and detach interrupt
     if (_pinToLow != -1) digitalWrite(_pinToLow, LOW);
-    detachInterrupt(_irqStatic);
+    if (!_eventMode) detachInterrupt(_irqNum);
 
     // call onTransmit function
     if (_onTransmit) {
         _onTransmit();
     }
+
+    // start next queued packet
+    if (_txQueueActive) _txQueueDone();
 }
 
 void SX127x::_interruptRx()
 {
     // store IRQ status
-    _statusIrq = sx127x_readRegister(SX127X_REG_IRQ_FLAGS);
+    _statusIrq = sx127x_readRegister(SX127X_REG_IRQ_FLAGS, &_ctx);
     // set IRQ status to RX done when interrupt occured before register updated
     if (!(_statusIrq & 0xF0)) _statusIrq = SX127X_IRQ_RX_DONE;
 
     // terminate receive mode by setting mode to standby
-    sx127x_writeBits(SX127X_REG_OP_MODE, SX127X_MODE_STDBY, 0, 3);
+    sx127x_writeBits(SX127X_REG_OP_MODE, SX127X_MODE_STDBY, 0, 3, &_ctx);
 
     // set back rxen pin to low and detach interrupt
     if (_pinToLow != -1) digitalWrite(_pinToLow, LOW);
-    detachInterrupt(_irqStatic);
+    if (!_eventMode) detachInterrupt(_irqNum);
 
     // set pointer to RX buffer base address and get packet payload length
-    sx127x_writeRegister(SX127X_REG_FIFO_ADDR_PTR, sx127x_readRegister(SX127X_REG_FIFO_RX_CURRENT_ADDR));
-    _payloadTxRx = sx127x_readRegister(SX127X_REG_RX_NB_BYTES);
+    sx127x_writeRegister(SX127X_REG_FIFO_ADDR_PTR, sx127x_readRegister(SX127X_REG_FIFO_RX_CURRENT_ADDR, &_ctx), &_ctx);
+    _payloadTxRx = sx127x_readRegister(SX127X_REG_RX_NB_BYTES, &_ctx);
+    _rxTime = _irqTime;
+    _stageLen = 0;
+    if (_packetHandler && (_statusIrq & SX127X_IRQ_RX_DONE)) _handlePacket(_statusIrq);
 
     // call onReceive function
     if (_onReceive) {
@@ -624,16 +1083,20 @@ void SX127x::_interruptRx()
 void SX127x::_interruptRxContinuous()
 {
     // store IRQ status
-    _statusIrq = sx127x_readRegister(SX127X_REG_IRQ_FLAGS);
+    _statusIrq = sx127x_readRegister(SX127X_REG_IRQ_FLAGS, &_ctx);
     // set IRQ status to RX done when interrupt occured before register updated
     if (!(_statusIrq & 0xF0)) _statusIrq = SX127X_IRQ_RX_DONE;
 
     // clear IRQ flag from last TX or RX operation
-    sx127x_writeRegister(SX127X_REG_IRQ_FLAGS, 0xFF);
+    sx127x_writeRegister(SX127X_REG_IRQ_FLAGS, 0xFF, &_ctx);
 
     // set pointer to RX buffer base address and get packet payload length
-    sx127x_writeRegister(SX127X_REG_FIFO_ADDR_PTR, sx127x_readRegister(SX127X_REG_FIFO_RX_CURRENT_ADDR));
-    _payloadTxRx = sx127x_readRegister(SX127X_REG_RX_NB_BYTES);
+    sx127x_writeRegister(SX127X_REG_FIFO_ADDR_PTR, sx127x_readRegister(SX127X_REG_FIFO_RX_CURRENT_ADDR, &_ctx), &_ctx);
+    _payloadTxRx = sx127x_readRegister(SX127X_REG_RX_NB_BYTES, &_ctx);
+    _rxTime = _irqTime;
+    _stageLen = 0;
+    if (_pool && (_statusIrq & SX127X_IRQ_RX_DONE)) _storePacket(_statusIrq);
+    if (_packetHandler && (_statusIrq & SX127X_IRQ_RX_DONE)) _handlePacket(_statusIrq);
 
     // call onReceive function
     if (_onReceive) {
@@ -641,6 +1104,95 @@ void SX127x::_interruptRxContinuous()
     }
 }
 
+void SX127x::_interruptCad()
+{
+    // store IRQ status
+    _statusIrq = sx127x_readRegister(SX127X_REG_IRQ_FLAGS, &_ctx);
+
+    // set back rxen pin to low and detach interrupt
+    if (_pinToLow != -1) digitalWrite(_pinToLow, LOW);
+    if (!_eventMode) detachInterrupt(_irqNum);
+}
+
+void SX127x::setPacketPool(LoRaPacket* pool, uint8_t size)
+{
+    // received packets in RX continuous operation copied to pool, one slot always kept empty
+    _pool = size > 1 ? pool : NULL;
+    _poolSize = _pool ? size : 0;
+    _poolHead = 0;
+    _poolTail = 0;
+    _poolDropped = 0;
+}
+
+uint8_t SX127x::packetsAvailable()
+{
+    if (_pool == NULL) return 0;
+    uint8_t head = _poolHead;
+    return (head + _poolSize - _poolTail) % _poolSize;
+}
+
+bool SX127x::readPacket(LoRaPacket* packet)
+{
+    // copy oldest packet from pool, only interrupt handler move head and only this method move tail
+    if (_pool == NULL || _poolTail == _poolHead) return false;
+    // slot must not be read before head checked
+    __asm__ volatile ("" ::: "memory");
+    *packet = _pool[_poolTail];
+    // slot copy must be complete before tail released to interrupt handler
+    __asm__ volatile ("" ::: "memory");
+    _poolTail = (_poolTail + 1) % _poolSize;
+    return true;
+}
+
+uint16_t SX127x::packetsDropped()
+{
+    return _poolDropped;
+}
+
+void SX127x::_storePacket(uint8_t irqStatus)
+{
+    // copy received packet and its status to pool slot at head, skip corrupted packet and drop packet when pool full
+    if (irqStatus & (SX127X_IRQ_CRC_ERR)) return;
+    uint8_t next = (_poolHead + 1) % _poolSize;
+    if (next == _poolTail) {
+        _poolDropped++;
+        return;
+    }
+    LoRaPacket* packet = &_pool[_poolHead];
+    LoRaPacketInfo info;
+    packetInfo(&info);
+    packet->length = _payloadTxRx;
+    sx127x_readBurst(SX127X_REG_FIFO, packet->data, packet->length, &_ctx);
+    packet->rssi = info.rssi;
+    packet->snr = info.snr;
+    packet->irqStatus = irqStatus;
+    packet->timestamp = info.timestamp;
+    // slot contents must be written before head published to readPacket
+    __asm__ volatile ("" ::: "memory");
+    _poolHead = next;
+    // packet already read from FIFO, keep payload length when packet handler also want it
+    if (_packetHandler == NULL) _payloadTxRx = 0;
+}
+
+void SX127x::_handlePacket(uint8_t irqStatus)
+{
+    // read whole payload in one burst to buffer from provider then pass it to handler with packet status
+    if (_payloadTxRx == 0 || (irqStatus & (SX127X_IRQ_CRC_ERR))) return;
+    LoRaPacketInfo info;
+    packetInfo(&info);
+    info.length = _payloadTxRx;
+    info.irqStatus = irqStatus;
+    uint8_t* buffer = _bufferProvider(_handlerContext, info.length);
+    if (buffer) {
+        // FIFO pointer rewound to packet start when packet pool already read it
+        if (_pool) sx127x_writeRegister(SX127X_REG_FIFO_ADDR_PTR, sx127x_readRegister(SX127X_REG_FIFO_RX_CURRENT_ADDR, &_ctx), &_ctx);
+        sx127x_readBurst(SX127X_REG_FIFO, buffer, info.length, &_ctx);
+        _packetHandler(_handlerContext, buffer, info.length, info);
+    }
+    // packet already consumed
+    _payloadTxRx = 0;
+}
+
 void SX127x::onTransmit(void(&callback)())
 {
     // register onTransmit function to call every transmit done
@@ -652,3 +1204,11 @@ void SX127x::onReceive(void(&callback)())
     // register onReceive function to call every receive done
     _onReceive = &callback;
 }
+
+void SX127x::onReceive(LoRaBufferProvider provider, LoRaPacketHandler handler, void* context)
+{
+    // register buffer provider and handler to receive every packet directly to caller buffer, set NULL to disable
+    _bufferProvider = provider;
+    _packetHandler = provider ? handler : NULL;
+    _handlerContext = context;
+}
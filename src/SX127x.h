@@ -2,6 +2,7 @@
 #define _SX127X_H_
 
 #include <BaseLoRa.h>
+#include <LoRaDutyCycle.h>
 #include <SX127x_driver.h>
 
 // TX and RX operation status
@@ -19,6 +20,12 @@
 #define SX127X_STATUS_CAD_DETECTED              LORA_STATUS_CAD_DETECTED
 #define SX127X_STATUS_CAD_DONE                  LORA_STATUS_CAD_DONE
 
+// Default Hardware Configuration
+#define SX127X_MAX_INSTANCES                    4           // maximum objects using interrupt handler
+#define SX127X_TX_QUEUE_SIZE                    4           // maximum packets in transmit queue
+#define SX127X_POLL_INTERVAL_MIN                100         // first IRQ status poll interval after expected finish in microsecond
+#define SX127X_POLL_INTERVAL_MAX                10000       // maximum IRQ status poll interval in microsecond
+
 #if defined(USE_LORA_SX126X) && defined(USE_LORA_SX127X)
 class SX127x : public BaseLoRa
 #else
@@ -28,6 +35,7 @@ class SX127x
     public:
 
         SX127x();
+        ~SX127x();
 
         // Common Operational methods
         bool begin();
@@ -48,9 +56,17 @@ class SX127x
         // Modem, modulation parameter, and packet parameter setup methods
         void setModem(uint8_t modem=SX127X_LORA_MODEM);
         void setFrequency(uint32_t frequency);
+        void setChannel(uint32_t channel);
+        void setHopTable(const uint32_t* channels, uint8_t count);
+        uint8_t hop();
+        void hop(uint8_t index);
+        static constexpr uint32_t channelWord(uint32_t frequency)
+        {
+            return ((uint64_t) frequency << SX127X_FRF_SHIFT) / SX127X_FRF_XTAL;
+        }
         void setTxPower(uint8_t txPower, uint8_t paPin=SX127X_TX_POWER_PA_BOOST);
         void setRxGain(uint8_t boost, uint8_t level=SX127X_RX_GAIN_AUTO);
-        void setLoRaModulation(uint8_t sf, uint32_t bw, uint8_t cr, bool ldro=false);
+        void setLoRaModulation(uint8_t sf, uint32_t bw, uint8_t cr, uint8_t ldro=SX127X_LDRO_OFF);
         void setLoRaPacket(uint8_t headerType, uint16_t preambleLength, uint8_t payloadLength, bool crcType=false, bool invertIq=false);
         void setSpreadingFactor(uint8_t sf);
         void setBandwidth(uint32_t bw);
@@ -65,86 +81,180 @@ class SX127x
 
         // Transmit related methods
         void beginPacket();
+        void setDutyCycle(LoRaDutyCycle* dutyCycle);
         bool endPacket(uint32_t timeout=0);
+        bool queuePacket(uint8_t* data, uint8_t length);
+        void setListenBeforeTalk(uint8_t attempts=3, uint32_t backoff=100);
+        uint8_t txQueued();
+        uint16_t txDropped();
         void write(uint8_t data);
         void write(uint8_t* data, uint8_t length);
         void write(char* data, uint8_t length);
-        template <typename T> void put(T data)
+        void writev(const LoRaSegment* segments, uint8_t count);
+        void writeAsync(uint8_t* data, uint8_t length, void(*callback)()=NULL);
+        template <typename T> void put(T data, uint8_t endian=LORA_LITTLE_ENDIAN)
         {
-            const uint8_t length = sizeof(T);
-            union conv {
-                T Data;
-                uint8_t Binary[length];
-            };
-            union conv u;
-            u.Data = data;
-            write(u.Binary, length);
+            uint8_t buf[sizeof(T)];
+            memcpy(buf, &data, sizeof(T));
+            lora_byteOrder(buf, sizeof(T), endian);
+            if (_stageWrite(buf, sizeof(T))) return;
+            sx127x_writeBurst(SX127X_REG_FIFO, buf, sizeof(T), &_ctx);
+            _payloadTxRx += sizeof(T);
         }
+        void setPacketBuffer(uint8_t* buffer, uint8_t size);
         void onTransmit(void(&callback)());
 
         // Receive related methods
         bool request(uint32_t timeout=SX127X_RX_SINGLE);
+        bool cad();
         uint8_t available();
         uint8_t read();
         uint8_t read(uint8_t* data, uint8_t length);
         uint8_t read(char* data, uint8_t length);
         void purge(uint8_t length=0);
-        template <typename T> uint8_t get(T &data)
+        template <typename T> uint8_t get(T &data, uint8_t endian=LORA_LITTLE_ENDIAN)
         {
-            const uint8_t length = sizeof(T);
-            union conv {
-                T Data;
-                uint8_t Binary[length];
-            };
-            union conv u;
-            uint8_t len = read(u.Binary, length);
-            data = u.Data;
+            uint8_t buf[sizeof(T)];
+            uint8_t len = read(buf, sizeof(T));
+            lora_byteOrder(buf, sizeof(T), endian);
+            memcpy(&data, buf, sizeof(T));
             return len;
         }
         void onReceive(void(&callback)());
+        void onReceive(LoRaBufferProvider provider, LoRaPacketHandler handler, void* context=NULL);
+        void setPacketPool(LoRaPacket* pool, uint8_t size);
+        uint8_t packetsAvailable();
+        bool readPacket(LoRaPacket* packet);
+        uint16_t packetsDropped();
 
         // Wait, operation status, and packet status methods
         bool wait(uint32_t timeout=0);
+        void setEventMode(bool enable=true);
+        bool process();
+        uint32_t pollCount();
         uint8_t status();
         uint32_t transmitTime();
+        uint32_t timeOnAir(uint8_t length);
         float dataRate();
         int16_t packetRssi();
         float snr();
+        void packetInfo(LoRaPacketInfo* info);
         int16_t rssi();
         uint32_t random();
 
     protected:
 
         uint8_t _modem;
-        uint32_t _frequency;
+        uint32_t _frequency = 0;
         uint8_t _sf = 7;
         uint32_t _bw = 125000;
+        uint8_t _cr = 5;
+        bool _ldro;
         uint8_t _headerType;
+        uint16_t _preambleLength = 8;
+        bool _crcType;
         uint8_t _payloadLength;
-        static void (*_onTransmit)();
-        static void (*_onReceive)();
+        void (*_onTransmit)() = NULL;
+        void (*_onReceive)() = NULL;
 
     private:
 
-        SPIClass* _spi;
-        int8_t _nss, _reset, _irq, _txen, _rxen;
+        sx127x_context _ctx;
+        int8_t _reset, _irq, _txen, _rxen;
         uint8_t _statusWait;
-        static uint8_t _statusIrq;
-        static uint32_t _transmitTime;
-        static uint8_t _payloadTxRx;
-        static int8_t _irqStatic;
-        static int8_t _pinToLow;
+        uint8_t _statusIrq = 0xFF;
+        uint32_t _transmitTime = 0;
+        uint8_t _payloadTxRx = 0;
+        int8_t _irqNum = -1;
+        int8_t _pinToLow = -1;
+        uint8_t _slot;
         uint16_t _random;
+        const uint32_t* _hopTable = NULL;
+        uint8_t _hopCount = 0;
+        uint8_t _hopIndex = 0;
+        LoRaDutyCycle* _dutyCycle = NULL;
+        uint8_t* _txQueueData[SX127X_TX_QUEUE_SIZE];
+        uint8_t _txQueueLength[SX127X_TX_QUEUE_SIZE];
+        volatile uint8_t _txQueueTail = 0;
+        volatile uint8_t _txQueueCount = 0;
+        volatile bool _txQueueActive = false;
+        volatile uint16_t _txDropped = 0;
+        uint8_t _version = 0;
+        uint32_t _rxTime = 0;
+        uint32_t _waitStart = 0;
+        uint32_t _waitExpected = 0;
+        uint32_t _pollCount = 0;
+        uint8_t _lbtAttempts = 0;
+        uint32_t _lbtBackoff = 1;
+        bool _inInterrupt = false;
+        bool _eventMode = false;
+        volatile bool _eventPending = false;
+        volatile uint32_t _irqTime = 0;
+        uint8_t* _stage = NULL;
+        uint8_t _stageSize = 0;
+        uint8_t _stageLen = 0;
+        uint8_t _stagePos = 0;
+        LoRaBufferProvider _bufferProvider = NULL;
+        LoRaPacketHandler _packetHandler = NULL;
+        void* _handlerContext = NULL;
+        LoRaPacket* _pool = NULL;
+        uint8_t _poolSize = 0;
+        volatile uint8_t _poolHead = 0;
+        volatile uint8_t _poolTail = 0;
+        volatile uint16_t _poolDropped = 0;
+
+        // Modulation config methods
+        static uint8_t _bwConfig(uint32_t bw);
+        void _setDetection(uint8_t sf);
+
+        // Transmit queue methods
+        void _txQueueStart();
+        void _txQueueDone();
+        void _txQueueRemove();
+
+        // RSSI offset from cached chip version and frequency band
+        int16_t _rssiOffset();
+
+        // Channel activity detection methods
+        void _cadStart();
+        bool _channelClear();
+
+        // Staging buffer methods
+        bool _stageWrite(const uint8_t* data, uint8_t length);
+        void _stageFlush();
+        void _stageLoad();
+
+        // Packet pool methods
+        void _storePacket(uint8_t irqStatus);
+        void _handlePacket(uint8_t irqStatus);
 
-        // Interrupt handler methods
+        // Interrupt handler methods, static handler for each instance slot forward interrupt to its object
+        static SX127x* _instances[SX127X_MAX_INSTANCES];
+        static void (*const _interrupts[SX127X_MAX_INSTANCES])();
 #ifdef ESP8266
-        static void ICACHE_RAM_ATTR _interruptTx();
-        static void ICACHE_RAM_ATTR _interruptRx();
-        static void ICACHE_RAM_ATTR _interruptRxContinuous();
+        static void ICACHE_RAM_ATTR _interrupt0();
+        static void ICACHE_RAM_ATTR _interrupt1();
+        static void ICACHE_RAM_ATTR _interrupt2();
+        static void ICACHE_RAM_ATTR _interrupt3();
+        void ICACHE_RAM_ATTR _interrupt();
+        void ICACHE_RAM_ATTR _dispatch();
+        static void ICACHE_RAM_ATTR _asyncIdle();
+        void ICACHE_RAM_ATTR _interruptTx();
+        void ICACHE_RAM_ATTR _interruptRx();
+        void ICACHE_RAM_ATTR _interruptRxContinuous();
+        void ICACHE_RAM_ATTR _interruptCad();
 #else
-        static void _interruptTx();
-        static void _interruptRx();
-        static void _interruptRxContinuous();
+        static void _interrupt0();
+        static void _interrupt1();
+        static void _interrupt2();
+        static void _interrupt3();
+        void _interrupt();
+        void _dispatch();
+        static void _asyncIdle();
+        void _interruptTx();
+        void _interruptRx();
+        void _interruptRxContinuous();
+        void _interruptCad();
 #endif
 
 };
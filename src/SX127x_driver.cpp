@@ -1,22 +1,59 @@
 #include <SX127x_driver.h>
 
-SPIClass* sx127x_spi = &SX127X_SPI;
-uint32_t sx127x_spiFrequency = SX127X_SPI_FREQUENCY;
-int8_t sx127x_nss = SX127X_PIN_NSS;
+sx127x_context sx127x_defaultContext = {&SX127X_SPI, SX127X_SPI_FREQUENCY, SX127X_PIN_NSS, {0}, 0
+#ifdef __AVR__
+    , NULL, 0
+#endif
+};
+sx127x_context* sx127x_activeContext = &sx127x_defaultContext;
+sx127x_context* sx127x_asyncContext = &sx127x_defaultContext;
+bool (*sx127x_asyncTransfer)(uint8_t* txBuf, uint8_t* rxBuf, uint16_t length) = NULL;
+void (*sx127x_asyncCallback)() = NULL;
+void (*sx127x_asyncIdle)() = NULL;
+volatile bool sx127x_asyncPending = false;
 
-void sx127x_setSPI(SPIClass &SpiObject, uint32_t frequency)
+static void sx127x_pinCache(sx127x_context* ctx)
 {
-    sx127x_spi = &SpiObject;
-    sx127x_spiFrequency = frequency ? frequency : sx127x_spiFrequency;
+#ifdef __AVR__
+    // cache port register and bit mask of pins so no pin table lookup on every transfer
+    ctx->nssPort = ctx->nss < 0 ? NULL : portOutputRegister(digitalPinToPort(ctx->nss));
+    ctx->nssMask = ctx->nss < 0 ? 0 : digitalPinToBitMask(ctx->nss);
+#else
+    (void) ctx;
+#endif
 }
 
-void sx127x_setPins(int8_t nss)
+static inline void sx127x_nssWrite(sx127x_context* ctx, uint8_t level)
 {
-    sx127x_nss = nss;
+#ifdef __AVR__
+    if (ctx->nssPort) {
+        // read modify write of port register must not be interrupted
+        uint8_t sreg = SREG;
+        cli();
+        if (level) *ctx->nssPort |= ctx->nssMask;
+        else *ctx->nssPort &= ~ctx->nssMask;
+        SREG = sreg;
+        return;
+    }
+#endif
+    digitalWrite(ctx->nss, level);
 }
 
-void sx127x_reset(int8_t reset)
+void sx127x_setSPI(SPIClass &SpiObject, uint32_t frequency, sx127x_context* ctx)
 {
+    ctx->spi = &SpiObject;
+    ctx->spiFrequency = frequency ? frequency : ctx->spiFrequency;
+}
+
+void sx127x_setPins(int8_t nss, sx127x_context* ctx)
+{
+    ctx->nss = nss;
+    sx127x_pinCache(ctx);
+}
+
+void sx127x_reset(int8_t reset, sx127x_context* ctx)
+{
+    sx127x_invalidateCache(ctx);
     pinMode(reset, OUTPUT);
     digitalWrite(reset, LOW);
     delay(1);
@@ -24,40 +61,210 @@ void sx127x_reset(int8_t reset)
     delay(5);
 }
 
-void sx127x_begin()
+void sx127x_begin(sx127x_context* ctx)
+{
+    pinMode(ctx->nss, OUTPUT);
+    sx127x_pinCache(ctx);
+    ctx->spi->begin();
+}
+
+void sx127x_setAsyncTransfer(bool (*asyncTransfer)(uint8_t* txBuf, uint8_t* rxBuf, uint16_t length))
+{
+    sx127x_asyncWait();
+    sx127x_asyncTransfer = asyncTransfer;
+}
+
+void sx127x_onAsyncIdle(void(*callback)())
+{
+    sx127x_asyncIdle = callback;
+}
+
+bool sx127x_asyncBusy()
+{
+    return sx127x_asyncPending;
+}
+
+bool sx127x_asyncWait(uint32_t timeout)
+{
+    if (!sx127x_asyncPending) return false;
+
+    // transfer routine never finished, release SPI bus without calling transfer callback so next transfer can start
+    uint32_t t = millis();
+    while (sx127x_asyncPending) {
+        if (millis() - t > timeout) {
+            sx127x_asyncContext->spi->endTransaction();
+            sx127x_nssWrite(sx127x_asyncContext, HIGH);
+            sx127x_asyncPending = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+void sx127x_asyncDone()
+{
+    // finish asynchronous transfer, must be called by asynchronous transfer routine when complete
+    sx127x_asyncContext->spi->endTransaction();
+    sx127x_nssWrite(sx127x_asyncContext, HIGH);
+    sx127x_asyncPending = false;
+    if (sx127x_asyncCallback) sx127x_asyncCallback();
+    if (sx127x_asyncIdle && !sx127x_asyncPending) sx127x_asyncIdle();
+}
+
+void sx127x_invalidateCache(sx127x_context* ctx)
+{
+    ctx->shadowValid = 0;
+}
+
+static uint8_t sx127x_shadowIndex(uint8_t address)
+{
+    // configuration registers which only change by writing them, other registers can be modified by device
+    switch (address) {
+        case SX127X_REG_FRF_MSB: return 0;
+        case SX127X_REG_FRF_MID: return 1;
+        case SX127X_REG_FRF_LSB: return 2;
+        case SX127X_REG_PA_CONFIG: return 3;
+        case SX127X_REG_OCP: return 4;
+        case SX127X_REG_FIFO_TX_BASE_ADDR: return 5;
+        case SX127X_REG_FIFO_RX_BASE_ADDR: return 6;
+        case SX127X_REG_MODEM_CONFIG_1: return 7;
+        case SX127X_REG_MODEM_CONFIG_2: return 8;
+        case SX127X_REG_SYMB_TIMEOUT: return 9;
+        case SX127X_REG_PREAMBLE_MSB: return 10;
+        case SX127X_REG_PREAMBLE_LSB: return 11;
+        case SX127X_REG_PAYLOAD_LENGTH: return 12;
+        case SX127X_REG_MODEM_CONFIG_3: return 13;
+        case SX127X_REG_DETECTION_OPTIMIZE: return 14;
+        case SX127X_REG_INVERTIQ: return 15;
+        case SX127X_REG_DETECTION_THRESHOLD: return 16;
+        case SX127X_REG_SYNC_WORD: return 17;
+        case SX127X_REG_INVERTIQ2: return 18;
+        case SX127X_REG_DIO_MAPPING_1: return 19;
+        case SX127X_REG_TCXO: return 20;
+        case SX127X_REG_PA_DAC: return 21;
+        default: return 0xFF;
+    }
+}
+
+static void sx127x_shadowStore(uint8_t address, uint8_t data, sx127x_context* ctx)
 {
-    pinMode(sx127x_nss, OUTPUT);
-    sx127x_spi->begin();
+    uint8_t index = sx127x_shadowIndex(address);
+    if (index == 0xFF) return;
+    ctx->shadow[index] = data;
+    ctx->shadowValid |= (uint32_t) 1 << index;
 }
 
-void sx127x_writeBits(uint8_t address, uint8_t data, uint8_t position, uint8_t length)
+void sx127x_writeBits(uint8_t address, uint8_t data, uint8_t position, uint8_t length, sx127x_context* ctx)
 {
-    uint8_t read = sx127x_transfer(address & 0x7F, 0x00);
+    // read register value from shadow cache when available so only one write needed
+    uint8_t read = sx127x_readRegister(address, ctx);
     uint8_t mask = (0xFF >> (8 - length)) << position;
     uint8_t write = (data << position) | (read & ~mask);
-    sx127x_transfer(address | 0x80, write);
+    sx127x_writeRegister(address, write, ctx);
+}
+
+void sx127x_writeRegister(uint8_t address, uint8_t data, sx127x_context* ctx)
+{
+    // skip writing configuration register which already has the same value
+    uint8_t index = sx127x_shadowIndex(address);
+    if (index != 0xFF && (ctx->shadowValid >> index) & 0x01) {
+        if (ctx->shadow[index] == data) return;
+    }
+    sx127x_transfer(address | 0x80, data, ctx);
+    sx127x_shadowStore(address, data, ctx);
+    // register content may change in sleep mode, e.g. switching modem
+    if (address == SX127X_REG_OP_MODE && (data & 0x07) == SX127X_MODE_SLEEP) sx127x_invalidateCache(ctx);
 }
 
-void sx127x_writeRegister(uint8_t address, uint8_t data)
+uint8_t sx127x_readRegister(uint8_t address, sx127x_context* ctx)
 {
-    sx127x_transfer(address | 0x80, data);
+    uint8_t index = sx127x_shadowIndex(address);
+    if (index != 0xFF && (ctx->shadowValid >> index) & 0x01) return ctx->shadow[index];
+    uint8_t data = sx127x_transfer(address & 0x7F, 0x00, ctx);
+    sx127x_shadowStore(address, data, ctx);
+    return data;
 }
 
-uint8_t sx127x_readRegister(uint8_t address)
+void sx127x_writeBurst(uint8_t address, uint8_t* data, uint8_t length, sx127x_context* ctx)
 {
-    return sx127x_transfer(address & 0x7F, 0x00);
+    sx127x_writeBurstAsync(address, data, length, NULL, ctx);
+    sx127x_asyncWait();
+}
+
+void sx127x_readBurst(uint8_t address, uint8_t* data, uint8_t length, sx127x_context* ctx)
+{
+    sx127x_readBurstAsync(address, data, length, NULL, ctx);
+    sx127x_asyncWait();
+    if (address == SX127X_REG_FIFO) return;
+    for (uint8_t i = 0; i < length; i++) sx127x_shadowStore(address + i, data[i], ctx);
+}
+
+void sx127x_writeBurstv(uint8_t address, const LoRaSegment* segments, uint8_t count, sx127x_context* ctx)
+{
+    sx127x_asyncWait();
+
+    // write all segments in one chip select window, segment data transferred byte by byte so caller buffer not overwritten
+    sx127x_nssWrite(ctx, LOW);
+    ctx->spi->beginTransaction(SPISettings(ctx->spiFrequency, MSBFIRST, SPI_MODE0));
+    ctx->spi->transfer(address | 0x80);
+    for (uint8_t i=0; i<count; i++) {
+        for (uint8_t j=0; j<segments[i].length; j++) ctx->spi->transfer(segments[i].data[j]);
+    }
+    ctx->spi->endTransaction();
+    sx127x_nssWrite(ctx, HIGH);
 }
 
-uint8_t sx127x_transfer(uint8_t address, uint8_t data)
+void sx127x_writeBurstAsync(uint8_t address, uint8_t* data, uint8_t length, void(*callback)(), sx127x_context* ctx)
 {
-    digitalWrite(sx127x_nss, LOW);
+    if (address != SX127X_REG_FIFO) {
+        for (uint8_t i = 0; i < length; i++) sx127x_shadowStore(address + i, data[i], ctx);
+    }
+    sx127x_transferAsync(address | 0x80, data, NULL, length, callback, ctx);
+}
+
+void sx127x_readBurstAsync(uint8_t address, uint8_t* data, uint8_t length, void(*callback)(), sx127x_context* ctx)
+{
+    sx127x_transferAsync(address & 0x7F, NULL, data, length, callback, ctx);
+}
+
+void sx127x_transferAsync(uint8_t address, uint8_t* txBuf, uint8_t* rxBuf, uint8_t length, void(*callback)(), sx127x_context* ctx)
+{
+    // previous asynchronous transfer must be finished before starting new one
+    sx127x_asyncWait();
+
+    // transfer multiple bytes in one chip select window, register address auto increment except for FIFO
+    sx127x_nssWrite(ctx, LOW);
+    ctx->spi->beginTransaction(SPISettings(ctx->spiFrequency, MSBFIRST, SPI_MODE0));
+    ctx->spi->transfer(address);
+
+    // stream data with asynchronous transfer routine, transfer finished when it calls sx127x_asyncDone()
+    sx127x_asyncContext = ctx;
+    sx127x_asyncCallback = callback;
+    sx127x_asyncPending = true;
+    if (sx127x_asyncTransfer && length) {
+        if (sx127x_asyncTransfer(txBuf, rxBuf, length)) return;
+    }
+
+    // fallback to blocking transfer directly from or into caller buffer
+    for (uint8_t i = 0; i < length; i++) {
+        uint8_t response = ctx->spi->transfer(txBuf ? txBuf[i] : 0x00);
+        if (rxBuf) rxBuf[i] = response;
+    }
+    sx127x_asyncDone();
+}
+
+uint8_t sx127x_transfer(uint8_t address, uint8_t data, sx127x_context* ctx)
+{
+    sx127x_asyncWait();
+
+    sx127x_nssWrite(ctx, LOW);
 
-    sx127x_spi->beginTransaction(SPISettings(sx127x_spiFrequency, MSBFIRST, SPI_MODE0));
-    sx127x_spi->transfer(address);
-    uint8_t response = sx127x_spi->transfer(data);
-    sx127x_spi->endTransaction();
+    ctx->spi->beginTransaction(SPISettings(ctx->spiFrequency, MSBFIRST, SPI_MODE0));
+    ctx->spi->transfer(address);
+    uint8_t response = ctx->spi->transfer(data);
+    ctx->spi->endTransaction();
 
-    digitalWrite(sx127x_nss, HIGH);
+    sx127x_nssWrite(ctx, HIGH);
 
     return response;
 }
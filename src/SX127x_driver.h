@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <SPI.h>
+#include <BaseLoRa.h>
 
 // SX127X register map
 #define SX127X_REG_FIFO                         0x00
@@ -74,6 +75,11 @@
 #define SX127X_RX_GAIN_BOOSTED                  0x01        //                       boosted gain
 #define SX127X_RX_GAIN_AUTO                     0x00        // option enable auto gain controller (AGC)
 
+// Low data rate optimize options
+#define SX127X_LDRO_OFF                         0x00        // low data rate optimize disabled
+#define SX127X_LDRO_ON                          0x01        // low data rate optimize enabled
+#define SX127X_LDRO_AUTO                        0x02        // enabled when symbol time longer than 16 ms
+
 // Header type
 #define SX127X_HEADER_EXPLICIT                  0x00        // explicit header mode
 #define SX127X_HEADER_IMPLICIT                  0x01        // implicit header mode
@@ -100,12 +106,19 @@
 #define SX127X_IRQ_RX_DONE                      0x40        // packet received
 #define SX127X_IRQ_RX_TIMEOUT                   0x80        // waiting packet received timeout
 
+// RF frequency
+#define SX127X_FRF_XTAL                         32000000    // XTAL frequency used for RF frequency calculation
+#define SX127X_FRF_SHIFT                        19          // Frf = Frequency * 2^19 / 32000000
+
 // Rssi offset
 #define SX127X_RSSI_OFFSET_LF                   164         // low band frequency RSSI offset
 #define SX127X_RSSI_OFFSET_HF                   157         // high band frequency RSSI offset
 #define SX1272_RSSI_OFFSET                      139         // frequency RSSI offset for SX1272
 #define SX127X_BAND_THRESHOLD                   525E6       // threshold between low and high band frequency
 
+// Register shadow cache
+#define SX127X_SHADOW_SIZE                      22          // number of configuration registers kept in shadow cache
+
 // TX and RX operation status
 #define SX127X_STATUS_DEFAULT                   LORA_STATUS_DEFAULT
 #define SX127X_STATUS_TX_WAIT                   LORA_STATUS_TX_WAIT
@@ -130,16 +143,51 @@
 #else
     #define SX127X_SPI_FREQUENCY                16000000    // Maximum LoRa SPI frequency
 #endif
-
-void sx127x_setSPI(SPIClass &SpiObject, uint32_t frequency);
-void sx127x_setPins(int8_t nss);
-void sx127x_reset(int8_t reset);
-void sx127x_begin();
+#define SX127X_ASYNC_TIMEOUT                    100         // Default timeout for asynchronous transfer to finish
+
+// SPI bus, pins, and register shadow cache used by driver functions, one context for each radio
+struct sx127x_context {
+    SPIClass* spi;
+    uint32_t spiFrequency;
+    int8_t nss;
+    uint8_t shadow[SX127X_SHADOW_SIZE];
+    uint32_t shadowValid;
+#ifdef __AVR__
+    volatile uint8_t* nssPort;                      // cached port register and bit mask for direct pin access
+    uint8_t nssMask;
+#endif
+};
+
+extern sx127x_context sx127x_defaultContext;
+// Context used by driver functions called without context, point to default context until changed e.g. by setActive()
+extern sx127x_context* sx127x_activeContext;
+
+void sx127x_setSPI(SPIClass &SpiObject, uint32_t frequency, sx127x_context* ctx=sx127x_activeContext);
+void sx127x_setPins(int8_t nss, sx127x_context* ctx=sx127x_activeContext);
+void sx127x_reset(int8_t reset, sx127x_context* ctx=sx127x_activeContext);
+void sx127x_begin(sx127x_context* ctx=sx127x_activeContext);
+
+// Asynchronous transfer routine (e.g. DMA) start streaming length bytes from txBuf (0x00 when NULL) and into rxBuf (discarded when NULL)
+// then return true, or return false to use blocking transfer. The routine must call sx127x_asyncDone() when transfer complete
+// Wait return true when transfer not done within timeout in millisecond, the transfer then aborted and SPI bus released
+// Idle callback called after every completed transfer, e.g. to run interrupt handler deferred while transfer used SPI bus
+void sx127x_setAsyncTransfer(bool (*asyncTransfer)(uint8_t* txBuf, uint8_t* rxBuf, uint16_t length));
+void sx127x_onAsyncIdle(void(*callback)());
+bool sx127x_asyncBusy();
+bool sx127x_asyncWait(uint32_t timeout=SX127X_ASYNC_TIMEOUT);
+void sx127x_asyncDone();
 
 // SX126x driver: Register access functions
-void sx127x_writeBits(uint8_t address, uint8_t data, uint8_t position, uint8_t length);
-void sx127x_writeRegister(uint8_t address, uint8_t data);
-uint8_t sx127x_readRegister(uint8_t address);
-uint8_t sx127x_transfer(uint8_t address, uint8_t data);
+void sx127x_invalidateCache(sx127x_context* ctx=sx127x_activeContext);
+void sx127x_writeBits(uint8_t address, uint8_t data, uint8_t position, uint8_t length, sx127x_context* ctx=sx127x_activeContext);
+void sx127x_writeRegister(uint8_t address, uint8_t data, sx127x_context* ctx=sx127x_activeContext);
+uint8_t sx127x_readRegister(uint8_t address, sx127x_context* ctx=sx127x_activeContext);
+void sx127x_writeBurst(uint8_t address, uint8_t* data, uint8_t length, sx127x_context* ctx=sx127x_activeContext);
+void sx127x_readBurst(uint8_t address, uint8_t* data, uint8_t length, sx127x_context* ctx=sx127x_activeContext);
+void sx127x_writeBurstv(uint8_t address, const LoRaSegment* segments, uint8_t count, sx127x_context* ctx=sx127x_activeContext);
+void sx127x_writeBurstAsync(uint8_t address, uint8_t* data, uint8_t length, void(*callback)()=NULL, sx127x_context* ctx=sx127x_activeContext);
+void sx127x_readBurstAsync(uint8_t address, uint8_t* data, uint8_t length, void(*callback)()=NULL, sx127x_context* ctx=sx127x_activeContext);
+void sx127x_transferAsync(uint8_t address, uint8_t* txBuf, uint8_t* rxBuf, uint8_t length, void(*callback)(), sx127x_context* ctx=sx127x_activeContext);
+uint8_t sx127x_transfer(uint8_t address, uint8_t data, sx127x_context* ctx=sx127x_activeContext);
 
 #endif
\ No newline at end of file